@@ -0,0 +1,78 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/*!
+ * @file FreeRTOSConfig.h
+ *
+ * @brief FreeRTOS configuration of the host benchmark (POSIX port)
+ *
+ * Mirrors the LPC17xx configuration where the firmware depends on it (priorities, tick rate, mutexes, notifications and timers). Each
+ * task runs on its own pthread, so the stacks are sized for the host instead.
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <stdint.h>
+
+#define configUSE_PREEMPTION                    1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define configUSE_IDLE_HOOK                     0
+#define configUSE_TICK_HOOK                     0
+#define configMAX_PRIORITIES                    ( 6 )
+#define configTICK_RATE_HZ                      ( ( TickType_t ) 1000 )
+#define configMINIMAL_STACK_SIZE                ( ( unsigned short ) 4096 )
+#define configTOTAL_HEAP_SIZE                   ( ( size_t ) ( 4 * 1024 * 1024 ) )
+#define configMAX_TASK_NAME_LEN                 ( 16 )
+#define configUSE_TRACE_FACILITY                1
+#define configUSE_16_BIT_TICKS                  0
+#define configIDLE_SHOULD_YIELD                 1
+#define configUSE_CO_ROUTINES                   0
+#define configUSE_MUTEXES                       1
+#define configUSE_COUNTING_SEMAPHORES           1
+#define configUSE_RECURSIVE_MUTEXES             0
+#define configQUEUE_REGISTRY_SIZE               8
+#define configGENERATE_RUN_TIME_STATS           0
+#define configUSE_MALLOC_FAILED_HOOK            0
+#define configCHECK_FOR_STACK_OVERFLOW          0
+#define configENABLE_BACKWARD_COMPATIBILITY     1
+#define configUSE_TASK_NOTIFICATIONS            1
+#define configSUPPORT_DYNAMIC_ALLOCATION        1
+#define configSUPPORT_STATIC_ALLOCATION         0
+
+#define configUSE_TIMERS                        1
+#define configTIMER_TASK_PRIORITY               5
+#define configTIMER_QUEUE_LENGTH                2
+#define configTIMER_TASK_STACK_DEPTH            configMINIMAL_STACK_SIZE
+
+void vAssertCalled( char* file, uint32_t line);
+#define configASSERT( x )     if( ( x ) == 0 ) { vAssertCalled( __FILE__, __LINE__ );}
+
+#define INCLUDE_vTaskPrioritySet                1
+#define INCLUDE_uxTaskPriorityGet               1
+#define INCLUDE_vTaskDelete                     1
+#define INCLUDE_vTaskCleanUpResources           1
+#define INCLUDE_vTaskSuspend                    1
+#define INCLUDE_vTaskDelayUntil                 1
+#define INCLUDE_vTaskDelay                      1
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
+#define INCLUDE_xTaskGetCurrentTaskHandle       1
+#define INCLUDE_xTaskGetSchedulerState          1
+
+#endif /* FREERTOS_CONFIG_H */
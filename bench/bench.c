@@ -0,0 +1,513 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/*!
+ * @file bench.c
+ *
+ * @brief IPMB/IPMI loopback benchmark
+ *
+ * Plays the MCH on a fake IPMB: request frames are handed to the IPMB slave receiver, go through the RX task, the IPMI dispatcher and
+ * the handlers, and the responses written by the TX task are collected from the fake I2C master. Each request mix is replayed a given
+ * amount of times, keeping up to a given window of requests outstanding, and the throughput and latency percentiles are reported.
+ *
+ * Requests sent by the MMC itself (platform events) are acknowledged right away, so they don't pile up in the event outbox.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "ipmi.h"
+#include "sdr.h"
+#include "utils.h"
+#include "task_priorities.h"
+#include "bench.h"
+
+/**
+ * @brief IPMB address taken by the MMC under test (AMC site 2)
+ */
+#define BENCH_MMC_ADDR          0x72
+
+/**
+ * @brief Time waited for a response before the outstanding requests are counted as lost
+ */
+#define BENCH_RSP_TIMEOUT       (1000/portTICK_PERIOD_MS)
+
+/**
+ * @brief Largest window accepted, the IPMB layer has only a few receive buffers
+ */
+#define BENCH_MAX_WINDOW        8
+
+/**
+ * @brief Bytes read by each Get SDR request, like ipmitool does
+ */
+#define BENCH_SDR_CHUNK         16
+
+/**
+ * @brief Firmware bytes carried by each HPM Upload Firmware Block request
+ */
+#define BENCH_HPM_BLOCK         20
+
+#define BENCH_RSPQUEUE_LEN      16
+
+typedef struct {
+    uint8_t netfn;
+    uint8_t cmd;
+    uint8_t data_len;
+    uint8_t data[IPMI_MSG_MAX_LENGTH];
+} bench_req;
+
+typedef struct {
+    uint64_t timestamp;
+    uint8_t seq;
+    uint8_t cmd;
+    uint8_t completion_code;
+    uint8_t data_len;
+    uint8_t data[IPMI_MSG_MAX_LENGTH];
+} bench_rsp;
+
+typedef struct {
+    const char * name;
+    const char * desc;
+    /* Sends whatever the mix needs before the timed part, returns false if the MMC refused it */
+    bool (* setup)( void );
+    /* Builds the n-th request of the mix */
+    void (* build)( uint32_t n, bench_req * req );
+} bench_mix;
+
+typedef struct {
+    uint16_t record_id;
+    uint8_t offset;
+    uint8_t size;
+} bench_sdr_read;
+
+static QueueHandle_t bench_rspqueue;
+
+static uint8_t bench_seq;
+static bool seq_busy[IPMB_SEQ_COUNT];
+static uint64_t seq_start[IPMB_SEQ_COUNT];
+
+static uint32_t bench_count = 10000;
+static uint8_t bench_window = 1;
+static const char * bench_mix_list = "sensor,sdr,hpm,mixed";
+static int bench_failed;
+
+static uint64_t bench_now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( (uint64_t) ts.tv_sec * 1000000000ULL ) + ts.tv_nsec;
+}
+
+static int bench_cmp_u32( const void * a, const void * b )
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+/**
+ * @brief Remote end of the bus, runs in the IPMB TX task
+ */
+static void bench_wire( const uint8_t * frame, uint8_t len )
+{
+    bench_rsp rsp;
+    uint8_t ack[IPMB_RESP_HEADER_LENGTH + 1];
+
+    if ( ( frame[0] != MCH_ADDRESS ) || ( len < IPMB_REQ_HEADER_LENGTH + 1 ) ) {
+        return;
+    }
+
+    if ( ( frame[1] >> 2 ) & 0x01 ) {
+        if ( len < IPMB_RESP_HEADER_LENGTH + 1 ) {
+            return;
+        }
+        rsp.timestamp = bench_now();
+        rsp.seq = frame[4] >> 2;
+        rsp.cmd = frame[5];
+        rsp.completion_code = frame[6];
+        rsp.data_len = len - IPMB_RESP_HEADER_LENGTH - 1;
+        memcpy( rsp.data, &frame[7], rsp.data_len );
+        xQueueSend( bench_rspqueue, &rsp, 0 );
+        return;
+    }
+
+    /* A request from the MMC, answer it with a bare completion code */
+    ack[0] = frame[3];
+    ack[1] = ( ( ( frame[1] >> 2 ) + 1 ) << 2 ) | ( frame[4] & IPMB_SRC_LUN_MASK );
+    ack[2] = calculate_chksum( ack, 2 );
+    ack[3] = MCH_ADDRESS;
+    ack[4] = frame[4] & IPMB_SEQ_MASK;
+    ack[5] = frame[5];
+    ack[6] = IPMI_CC_OK;
+    ack[7] = calculate_chksum( &ack[3], 4 );
+    bench_i2c_inject( ack, sizeof(ack) );
+}
+
+/**
+ * @brief Encodes a request from the MCH and delivers it to the MMC
+ */
+static void bench_send( bench_req * req, uint8_t seq )
+{
+    uint8_t frame[IPMI_MSG_MAX_LENGTH];
+    uint8_t len = 0;
+
+    frame[len++] = ipmb_addr;
+    frame[len++] = req->netfn << 2;
+    frame[len++] = calculate_chksum( frame, 2 );
+    frame[len++] = MCH_ADDRESS;
+    frame[len++] = seq << 2;
+    frame[len++] = req->cmd;
+    memcpy( &frame[len], req->data, req->data_len );
+    len += req->data_len;
+    frame[len] = calculate_chksum( &frame[3], len - 3 );
+    len++;
+
+    bench_i2c_inject( frame, len );
+}
+
+static uint8_t bench_alloc_seq( void )
+{
+    while ( seq_busy[bench_seq] ) {
+        bench_seq = ( bench_seq + 1 ) % IPMB_SEQ_COUNT;
+    }
+    seq_busy[bench_seq] = true;
+
+    return bench_seq;
+}
+
+/**
+ * @brief Sends a single request and waits for its response, used to prepare the mixes
+ */
+static bool bench_transact( bench_req * req, bench_rsp * rsp )
+{
+    uint8_t seq = bench_alloc_seq();
+
+    bench_send( req, seq );
+
+    while ( xQueueReceive( bench_rspqueue, rsp, BENCH_RSP_TIMEOUT ) == pdTRUE ) {
+        if ( rsp->seq == seq ) {
+            seq_busy[seq] = false;
+            return ( rsp->completion_code == IPMI_CC_OK );
+        }
+    }
+
+    seq_busy[seq] = false;
+    return false;
+}
+
+/* Get Sensor Reading storm */
+
+static void bench_sensor_build( uint32_t n, bench_req * req )
+{
+    req->netfn = NETFN_SE;
+    req->cmd = IPMI_GET_SENSOR_READING_CMD;
+    /* Sensor 0 is the device locator record */
+    req->data[0] = 1 + ( n % bench_sensor_count );
+    req->data_len = 1;
+}
+
+/* SDR repository dump */
+
+static uint16_t sdr_reservation;
+static bench_sdr_read * sdr_plan;
+static uint32_t sdr_plan_len;
+
+static bool bench_sdr_setup( void )
+{
+    bench_req req = { .netfn = NETFN_SE, .cmd = IPMI_RESERVE_DEVICE_SDR_REPOSITORY_CMD, .data_len = 0 };
+    bench_rsp rsp;
+    sensor_t * entry;
+    uint16_t record_id = 0;
+    uint8_t offset;
+
+    if ( !bench_transact( &req, &rsp ) || ( rsp.data_len < 2 ) ) {
+        return false;
+    }
+    sdr_reservation = rsp.data[0] | ( rsp.data[1] << 8 );
+
+    /* Same reads as ipmitool: the record header, then the body in chunks */
+    free( sdr_plan );
+    sdr_plan = malloc( sdr_count * ( 1 + ( 255 / BENCH_SDR_CHUNK ) + 1 ) * sizeof(bench_sdr_read) );
+    sdr_plan_len = 0;
+
+    for ( entry = sdr_head; entry != NULL; entry = entry->next, record_id++ ) {
+        sdr_plan[sdr_plan_len++] = (bench_sdr_read) { record_id, 0, sizeof(SDR_entry_hdr_t) };
+
+        for ( offset = sizeof(SDR_entry_hdr_t); offset < entry->sdr_length; offset += BENCH_SDR_CHUNK ) {
+            sdr_plan[sdr_plan_len].record_id = record_id;
+            sdr_plan[sdr_plan_len].offset = offset;
+            sdr_plan[sdr_plan_len].size = ( entry->sdr_length - offset > BENCH_SDR_CHUNK ) ? BENCH_SDR_CHUNK : ( entry->sdr_length - offset );
+            sdr_plan_len++;
+        }
+    }
+
+    return ( sdr_plan_len > 0 );
+}
+
+static void bench_sdr_build( uint32_t n, bench_req * req )
+{
+    bench_sdr_read * read = &sdr_plan[n % sdr_plan_len];
+
+    req->netfn = NETFN_SE;
+    req->cmd = IPMI_GET_DEVICE_SDR_CMD;
+    req->data[0] = sdr_reservation & 0xFF;
+    req->data[1] = sdr_reservation >> 8;
+    req->data[2] = read->record_id & 0xFF;
+    req->data[3] = read->record_id >> 8;
+    req->data[4] = read->offset;
+    req->data[5] = read->size;
+    req->data_len = 6;
+}
+
+/* HPM upload of the payload component */
+
+static bool bench_hpm_setup( void )
+{
+    bench_req req = { .netfn = NETFN_GRPEXT, .cmd = IPMI_PICMG_CMD_HPM_INITIATE_UPGRADE_ACTION, .data_len = 3 };
+    bench_rsp rsp;
+
+    req.data[0] = IPMI_PICMG_GRP_EXT;
+    /* Payload component, upload for upgrade */
+    req.data[1] = 0x04;
+    req.data[2] = 0x02;
+
+    return bench_transact( &req, &rsp );
+}
+
+static void bench_hpm_build( uint32_t n, bench_req * req )
+{
+    req->netfn = NETFN_GRPEXT;
+    req->cmd = IPMI_PICMG_CMD_HPM_UPLOAD_FIRMWARE_BLOCK;
+    req->data[0] = IPMI_PICMG_GRP_EXT;
+    req->data[1] = n & 0xFF;
+    memset( &req->data[2], n & 0xFF, BENCH_HPM_BLOCK );
+    req->data_len = 2 + BENCH_HPM_BLOCK;
+}
+
+/* What a shelf manager does in steady state: mostly sensor polling, some SDR reads and device discovery */
+
+static void bench_mixed_build( uint32_t n, bench_req * req )
+{
+    switch ( n % 10 ) {
+    case 7:
+    case 8:
+        bench_sdr_build( n, req );
+        break;
+    case 9:
+        req->netfn = NETFN_APP;
+        req->cmd = IPMI_GET_DEVICE_ID_CMD;
+        req->data_len = 0;
+        break;
+    default:
+        bench_sensor_build( n, req );
+        break;
+    }
+}
+
+static const bench_mix bench_mixes[] = {
+    { "sensor", "Get Sensor Reading storm", NULL, bench_sensor_build },
+    { "sdr", "SDR repository dump", bench_sdr_setup, bench_sdr_build },
+    { "hpm", "HPM firmware block upload", bench_hpm_setup, bench_hpm_build },
+    { "mixed", "Sensor readings, SDR reads and Get Device ID", bench_sdr_setup, bench_mixed_build },
+};
+
+static void bench_run( const bench_mix * mix )
+{
+    uint32_t * latency = malloc( bench_count * sizeof(uint32_t) );
+    uint32_t sent = 0, done = 0, lost = 0, errors = 0;
+    uint32_t inflight = 0;
+    uint32_t frames_start;
+    uint32_t dropped_start, dropped_seen;
+    ipmb_link_stats stats;
+    uint64_t t_start, t_end, sum = 0;
+    bench_req req;
+    bench_rsp rsp;
+    uint8_t seq;
+    double elapsed;
+
+    if ( mix->setup && !mix->setup() ) {
+        printf( "%-8s setup failed\n", mix->name );
+        bench_failed = 1;
+        free( latency );
+        return;
+    }
+
+    frames_start = bench_wire_frames;
+    ipmb_get_link_stats( &stats );
+    dropped_start = dropped_seen = stats.tx_failures;
+    t_start = bench_now();
+
+    while ( ( sent < bench_count ) || ( inflight > 0 ) ) {
+        while ( ( inflight < bench_window ) && ( sent < bench_count ) ) {
+            mix->build( sent, &req );
+            seq = bench_alloc_seq();
+            seq_start[seq] = bench_now();
+            bench_send( &req, seq );
+            inflight++;
+            sent++;
+        }
+
+        if ( xQueueReceive( bench_rspqueue, &rsp, BENCH_RSP_TIMEOUT ) != pdTRUE ) {
+            /* Give up on everything outstanding, the retransmissions would only skew the figures */
+            lost += inflight;
+            inflight = 0;
+            memset( seq_busy, 0, sizeof(seq_busy) );
+
+            /* A response the MMC dropped after all its retries is expected with NAKs, anything else is a bug */
+            ipmb_get_link_stats( &stats );
+            if ( stats.tx_failures == dropped_seen ) {
+                bench_failed = 1;
+            }
+            dropped_seen = stats.tx_failures;
+            continue;
+        }
+
+        if ( !seq_busy[rsp.seq] ) {
+            /* Response to a request already counted as lost */
+            continue;
+        }
+
+        seq_busy[rsp.seq] = false;
+        inflight--;
+        latency[done] = (uint32_t) ( rsp.timestamp - seq_start[rsp.seq] );
+        sum += latency[done];
+        done++;
+
+        if ( rsp.completion_code != IPMI_CC_OK ) {
+            errors++;
+        }
+    }
+
+    t_end = bench_now();
+    elapsed = ( t_end - t_start ) / 1e9;
+    ipmb_get_link_stats( &stats );
+
+    if ( done > 0 ) {
+        qsort( latency, done, sizeof(uint32_t), bench_cmp_u32 );
+        printf( "%-8s %8u %6u %7u %6u %8u %10.0f %8.1f %8.1f %8.1f %8.1f %8.1f\n", mix->name, done, lost,
+                stats.tx_failures - dropped_start, errors, bench_wire_frames - frames_start, done / elapsed, ( sum / done ) / 1e3, latency[done / 2] / 1e3,
+                latency[( done * 90 ) / 100] / 1e3, latency[( done * 99 ) / 100] / 1e3, latency[done - 1] / 1e3 );
+    } else {
+        printf( "%-8s no response received\n", mix->name );
+    }
+
+    free( latency );
+}
+
+static void BenchTask( void * pvParameters )
+{
+    char list[64];
+    char * name;
+    size_t i;
+
+    printf( "%u requests per mix, window %u, %u sensors, %u%% NAK\n", bench_count, bench_window, bench_sensor_count,
+            bench_nak_percent );
+    printf( "%-8s %8s %6s %7s %6s %8s %10s %8s %8s %8s %8s %8s\n", "mix", "done", "lost", "dropped", "errors", "frames", "msg/s",
+            "mean(us)", "p50(us)", "p90(us)", "p99(us)", "max(us)" );
+
+    strncpy( list, bench_mix_list, sizeof(list) - 1 );
+    list[sizeof(list) - 1] = '\0';
+
+    for ( name = strtok( list, "," ); name != NULL; name = strtok( NULL, "," ) ) {
+        for ( i = 0; i < sizeof(bench_mixes) / sizeof(bench_mixes[0]); i++ ) {
+            if ( strcmp( name, bench_mixes[i].name ) == 0 ) {
+                bench_run( &bench_mixes[i] );
+                break;
+            }
+        }
+        if ( i == sizeof(bench_mixes) / sizeof(bench_mixes[0]) ) {
+            printf( "%-8s unknown mix\n", name );
+            bench_failed = 1;
+        }
+    }
+
+    fflush( stdout );
+    exit( bench_failed );
+}
+
+static void bench_usage( const char * prog )
+{
+    size_t i;
+
+    fprintf( stderr, "Usage: %s [-m mix[,mix...]] [-n count] [-w window] [-s sensors] [-l nak_percent]\n\nMixes:\n", prog );
+    for ( i = 0; i < sizeof(bench_mixes) / sizeof(bench_mixes[0]); i++ ) {
+        fprintf( stderr, "  %-8s %s\n", bench_mixes[i].name, bench_mixes[i].desc );
+    }
+}
+
+int main( int argc, char ** argv )
+{
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "m:n:w:s:l:h" ) ) != -1 ) {
+        switch ( opt ) {
+        case 'm':
+            bench_mix_list = optarg;
+            break;
+        case 'n':
+            bench_count = strtoul( optarg, NULL, 0 );
+            break;
+        case 'w':
+            bench_window = strtoul( optarg, NULL, 0 );
+            break;
+        case 's':
+            bench_sensor_count = strtoul( optarg, NULL, 0 );
+            break;
+        case 'l':
+            bench_nak_percent = strtoul( optarg, NULL, 0 );
+            break;
+        default:
+            bench_usage( argv[0] );
+            return 2;
+        }
+    }
+
+    if ( ( bench_count == 0 ) || ( bench_window == 0 ) || ( bench_window > BENCH_MAX_WINDOW ) || ( bench_sensor_count == 0 ) ||
+         ( bench_sensor_count > 200 ) || ( bench_nak_percent > 90 ) ) {
+        bench_usage( argv[0] );
+        return 2;
+    }
+
+    ipmb_addr = BENCH_MMC_ADDR;
+
+    sdr_init();
+    sensor_init();
+
+    bench_rspqueue = xQueueCreate( BENCH_RSPQUEUE_LEN, sizeof(bench_rsp) );
+    bench_i2c_set_wire_cb( bench_wire );
+
+    /* NOTE: ipmb_init() is called inside this function */
+    ipmi_init();
+
+    /* Lowest priority, the MCH is a separate device and the MMC tasks must never wait on it */
+    xTaskCreate( BenchTask, (const char*)"Bench", configMINIMAL_STACK_SIZE, ( void * ) NULL, tskIDLE_PRIORITY+1, ( TaskHandle_t * ) NULL );
+
+    vTaskStartScheduler();
+
+    return 1;
+}
@@ -0,0 +1,69 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/*!
+ * @file bench.h
+ *
+ * @brief Interface between the benchmark driver and the host port layer
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Called for every frame written by the IPMB TX task, in its context
+ *
+ * @param frame Whole IPMB frame, starting with the destination address
+ * @param len Frame length in bytes
+ */
+typedef void (* bench_wire_cb_t)( const uint8_t * frame, uint8_t len );
+
+/**
+ * @brief Registers the remote end of the fake I2C bus
+ */
+void bench_i2c_set_wire_cb( bench_wire_cb_t cb );
+
+/**
+ * @brief Delivers a frame to the IPMB slave receiver, as the I2C interrupt would
+ *
+ * The frame is dropped by the IPMB layer (and counted in its link statistics) if no receive buffer is available.
+ *
+ * @param frame Whole IPMB frame, starting with the destination address
+ * @param len Frame length in bytes
+ */
+void bench_i2c_inject( const uint8_t * frame, uint8_t len );
+
+/**
+ * @brief Percentage of master writes answered with a NAK, to exercise the IPMB retries
+ */
+extern uint8_t bench_nak_percent;
+
+/**
+ * @brief Frames written on the bus by the IPMB TX task (retries included)
+ */
+extern uint32_t bench_wire_frames;
+
+/**
+ * @brief Threshold sensors added to the SDR repository by #amc_sdr_init
+ */
+extern uint8_t bench_sensor_count;
+
+#endif
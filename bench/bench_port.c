@@ -0,0 +1,294 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/*!
+ * @file bench_port.c
+ *
+ * @brief Host port layer of the IPMB/IPMI benchmark
+ *
+ * The fake I2C driver has no bus timing: a master write hands the whole frame to the simulated MCH (see #bench_i2c_set_wire_cb) and
+ * #bench_i2c_inject delivers a frame to the slave receiver the same way the I2C interrupt does on the board.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "port.h"
+#include "payload.h"
+#include "ipmi.h"
+#include "utils.h"
+#include "bench.h"
+
+/* I2C */
+
+static uint8_t * slave_rx_buff;
+static uint8_t slave_buff_len;
+static i2c_slave_rx_cb_t slave_rx_cb;
+static bench_wire_cb_t wire_cb;
+
+uint8_t bench_nak_percent;
+uint32_t bench_wire_frames;
+
+/* The fake bus has no arbitration, timeouts or bus errors, these stay at 0 */
+uint32_t i2c_arb_lost_count[I2C_NUM_INTERFACE];
+uint32_t i2c_timeout_count[I2C_NUM_INTERFACE];
+uint32_t i2c_bus_err_count[I2C_NUM_INTERFACE];
+uint32_t i2c_recovery_count[I2C_NUM_INTERFACE];
+
+void vI2CConfig( I2C_ID_T id, uint32_t speed )
+{
+}
+
+void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr, uint8_t * rx_buff, uint8_t buff_len, i2c_slave_rx_cb_t rx_cb )
+{
+    slave_rx_buff = rx_buff;
+    slave_buff_len = buff_len;
+    slave_rx_cb = rx_cb;
+}
+
+I2C_STATUS_T xI2CMasterWriteStatus(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, int tx_len)
+{
+    uint8_t frame[IPMI_MSG_MAX_LENGTH];
+
+    if ( ( tx_len <= 0 ) || ( tx_len >= IPMI_MSG_MAX_LENGTH ) ) {
+        return I2C_STATUS_BUSERR;
+    }
+
+    bench_wire_frames++;
+
+    /* Nobody acknowledges the address, the TX task will back off and retry */
+    if ( ( bench_nak_percent > 0 ) && ( (uint8_t) ( rand() % 100 ) < bench_nak_percent ) ) {
+        return I2C_STATUS_NAK;
+    }
+
+    /* Put the address byte back, the remote side sees the same frame as the slave receiver does */
+    frame[0] = addr << 1;
+    memcpy( &frame[1], tx_buff, tx_len );
+
+    if ( wire_cb ) {
+        wire_cb( frame, tx_len + 1 );
+    }
+
+    return I2C_STATUS_DONE;
+}
+
+void bench_i2c_set_wire_cb( bench_wire_cb_t cb )
+{
+    wire_cb = cb;
+}
+
+void bench_i2c_inject( const uint8_t * frame, uint8_t len )
+{
+    BaseType_t woken = pdFALSE;
+
+    if ( ( slave_rx_cb == NULL ) || ( len < 2 ) || ( len > slave_buff_len + 1 ) ) {
+        return;
+    }
+
+    /* Same path as the I2C interrupt: the address byte isn't stored, the callback swaps the buffer */
+    taskENTER_CRITICAL();
+    memcpy( slave_rx_buff, &frame[1], len - 1 );
+    slave_rx_buff = slave_rx_cb( slave_rx_buff, len - 1, &woken );
+    taskEXIT_CRITICAL();
+
+    if ( woken ) {
+        taskYIELD();
+    }
+}
+
+/* Payload */
+
+void payload_send_message( uint8_t fru_id, EventBits_t msg )
+{
+}
+
+uint8_t payload_hpm_prepare_comp( void )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t payload_hpm_upload_block( uint8_t * block, uint16_t size )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t payload_hpm_finish_upload( uint32_t image_size )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t payload_hpm_get_upgrade_status( void )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t payload_hpm_activate_firmware( void )
+{
+    return IPMI_CC_OK;
+}
+
+/* HPM flash hooks, the MMC and bootloader components are never written by the benchmark */
+
+uint8_t ipmc_hpm_prepare_comp( void )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t ipmc_hpm_upload_block( uint8_t * block, uint16_t size )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t ipmc_hpm_finish_upload( uint32_t image_size )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t ipmc_hpm_activate_firmware( void )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t ipmc_hpm_get_upgrade_status( void )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t bootloader_hpm_prepare_comp( void )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t bootloader_hpm_upload_block( uint8_t * block, uint16_t size )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t bootloader_hpm_finish_upload( uint32_t image_size )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t bootloader_hpm_activate_firmware( void )
+{
+    return IPMI_CC_OK;
+}
+
+uint8_t bootloader_hpm_get_upgrade_status( void )
+{
+    return IPMI_CC_OK;
+}
+
+/* Sensors */
+
+uint8_t bench_sensor_count = 32;
+
+const SDR_type_01h_t SDR_BENCH = {
+
+    .hdr.recID_LSB = 0x00, /* Filled by sdr_insert_entry() */
+    .hdr.recID_MSB = 0x00,
+    .hdr.SDRversion = 0x51,
+    .hdr.rectype = TYPE_01,
+    .hdr.reclength = sizeof(SDR_type_01h_t) - sizeof(SDR_entry_hdr_t),
+
+    .ownerID = 0x00, /* i2c address, -> SDR_Init */
+    .ownerLUN = 0x00, /* sensor owner LUN */
+    .sensornum = 0x00, /* Filled by sdr_insert_entry() */
+
+    /* record body bytes */
+    .entityID = 0xC1, /* entity id: AMC Module */
+    .entityinstance = 0x00, /* entity instance -> SDR_Init */
+    .sensorinit = 0x7F, /* init: event generation + scanning enabled */
+    .sensorcap = 0x56, /* capabilities: auto re-arm,*/
+    .sensortype = SENSOR_TYPE_VOLTAGE, /* sensor type: Voltage*/
+    .event_reading_type = 0x01, /* sensor reading*/
+    .assertion_event_mask = 0x7A95, /* assertion event mask (All upper going-high and lower going-low events) */
+    .deassertion_event_mask = 0x7A95, /* deassertion event mask (All upper going-high and lower going-low events) */
+    .readable_threshold_mask = 0x3F, /* LSB: readable Threshold mask: all thresholds are readable:  */
+    .settable_threshold_mask = 0x00, /* MSB: setable Threshold mask: none of the thresholds are setable: */
+    .sensor_units_1 = 0x00, /* sensor units 1 :*/
+    .sensor_units_2 = 0x04, /* sensor units 2 :*/
+    .sensor_units_3 = 0x00, /* sensor units 3 :*/
+    .linearization = 0x00, /* Linearization */
+    .M = 64, /* M */
+    .M_tol = 0x00, /* M - Tolerance */
+    .B = 0x00, /* B */
+    .B_accuracy = 0x00, /* B - Accuracy */
+    .acc_exp_sensor_dir = 0x02, /* Sensor direction */
+    .Rexp_Bexp = 0xD0, /* R-Exp = -3 , B-Exp = 0 */
+    .analog_flags = 0x03, /* Analogue characteristics flags */
+    .nominal_reading = (12000 >> 6), /* Nominal reading = 12.032 V */
+    .normal_max = (13000 >> 6), /* Normal maximum = 12.992 V */
+    .normal_min = (11000 >> 6), /* Normal minimum = 10.944 V */
+    .sensor_max_reading = 0xFF, /* Sensor Maximum reading */
+    .sensor_min_reading = 0x00, /* Sensor Minimum reading */
+    .upper_nonrecover_thr = (16000 >> 6), /* Upper non-recoverable Threshold */
+    .upper_critical_thr = (15000 >> 6), /* Upper critical Threshold */
+    .upper_noncritical_thr = (14000 >> 6), /* Upper non critical Threshold */
+    .lower_nonrecover_thr = (8000 >> 6), /* Lower non-recoverable Threshold */
+    .lower_critical_thr = (9000 >> 6), /* Lower critical Threshold */
+    .lower_noncritical_thr = (10000 >> 6), /* Lower non-critical Threshold */
+    .pos_thr_hysteresis = 2, /* positive going Threshold hysteresis value */
+    .neg_thr_hysteresis = 2, /* negative going Threshold hysteresis value */
+    .reserved1 = 0x00, /* reserved */
+    .reserved2 = 0x00, /* reserved */
+    .OEM = 0x00, /* OEM reserved */
+    .IDtypelen = 0xc0 | STR_SIZE("BENCH +12V"), /* 8 bit ASCII, number of bytes */
+    .IDstring = "BENCH +12V" /* sensor string */
+};
+
+void amc_sdr_init( void )
+{
+    sensor_t * entry;
+
+    /* All the sensors share the same record, Get SDR patches the record and sensor numbers on the fly */
+    for ( uint8_t i = 0; i < bench_sensor_count; i++ ) {
+        entry = sdr_insert_entry( TYPE_01, (void *) &SDR_BENCH, NULL, 0, 0 );
+        entry->readout_value = 12000 >> 6;
+        entry->state = SENSOR_STATE_NORMAL;
+    }
+}
+
+/* FreeRTOS */
+
+/* The firmware sizes its stacks for the Cortex-M3, here each task is a pthread which needs a lot more */
+BaseType_t __real_xTaskCreate( TaskFunction_t pxTaskCode, const char * const pcName, const configSTACK_DEPTH_TYPE usStackDepth,
+                               void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask );
+
+BaseType_t __wrap_xTaskCreate( TaskFunction_t pxTaskCode, const char * const pcName, const configSTACK_DEPTH_TYPE usStackDepth,
+                               void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask )
+{
+    configSTACK_DEPTH_TYPE depth = usStackDepth;
+
+    if ( depth < configMINIMAL_STACK_SIZE ) {
+        depth = configMINIMAL_STACK_SIZE;
+    }
+
+    return __real_xTaskCreate( pxTaskCode, pcName, depth, pvParameters, uxPriority, pxCreatedTask );
+}
+
+void vAssertCalled( char* file, uint32_t line)
+{
+    fprintf( stderr, "Assertion failed at %s:%u\n", file, (unsigned int) line );
+    abort();
+}
@@ -0,0 +1,47 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/*!
+ * @file payload.h
+ *
+ * @brief Payload interface seen by the IPMI handlers in the host benchmark
+ *
+ * FRU control requests are accepted and dropped, HPM payload uploads are accepted without touching any flash.
+ */
+
+#ifndef PAYLOAD_H_
+#define PAYLOAD_H_
+
+#include "FreeRTOS.h"
+#include "event_groups.h"
+
+#define PAYLOAD_MESSAGE_COLD_RST        (1 << 0)
+#define PAYLOAD_MESSAGE_WARM_RST        (1 << 1)
+#define PAYLOAD_MESSAGE_REBOOT          (1 << 2)
+#define PAYLOAD_MESSAGE_QUIESCE         (1 << 3)
+
+void payload_send_message( uint8_t fru_id, EventBits_t msg );
+
+uint8_t payload_hpm_prepare_comp( void );
+uint8_t payload_hpm_upload_block( uint8_t * block, uint16_t size );
+uint8_t payload_hpm_finish_upload( uint32_t image_size );
+uint8_t payload_hpm_get_upgrade_status( void );
+uint8_t payload_hpm_activate_firmware( void );
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/*!
+ * @file port.h
+ *
+ * @brief Host port layer used by the IPMB/IPMI benchmark
+ *
+ * Takes the place of the microcontroller port.h when the IPMB, IPMI, SDR and HPM modules are built for the build machine. Only the
+ * functions those modules call are provided: a fake I2C driver which loops every frame back to the benchmark (see bench_port.c) and
+ * no-op HPM flash hooks.
+ */
+
+#ifndef PORT_H_
+#define PORT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+
+/* I2C */
+
+typedef enum I2C_ID {
+    I2C0,
+    I2C1,
+    I2C2,
+    I2C_NUM_INTERFACE
+} I2C_ID_T;
+
+typedef enum {
+    I2C_STATUS_DONE,
+    I2C_STATUS_NAK,
+    I2C_STATUS_ARBLOST,
+    I2C_STATUS_BUSERR,
+    I2C_STATUS_BUSY
+} I2C_STATUS_T;
+
+typedef uint8_t * (* i2c_slave_rx_cb_t)( uint8_t * rx_buff, uint8_t rx_len, BaseType_t * pxHigherPriorityTaskWoken );
+
+void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr, uint8_t * rx_buff, uint8_t buff_len, i2c_slave_rx_cb_t rx_cb );
+void vI2CConfig( I2C_ID_T id, uint32_t speed );
+I2C_STATUS_T xI2CMasterWriteStatus(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, int tx_len);
+
+extern uint32_t i2c_arb_lost_count[I2C_NUM_INTERFACE];
+extern uint32_t i2c_timeout_count[I2C_NUM_INTERFACE];
+extern uint32_t i2c_bus_err_count[I2C_NUM_INTERFACE];
+extern uint32_t i2c_recovery_count[I2C_NUM_INTERFACE];
+
+/* HPM flash hooks */
+
+uint8_t ipmc_hpm_prepare_comp(void);
+uint8_t ipmc_hpm_upload_block(uint8_t *block, uint16_t size);
+uint8_t ipmc_hpm_finish_upload(uint32_t image_size);
+uint8_t ipmc_hpm_activate_firmware(void);
+uint8_t ipmc_hpm_get_upgrade_status(void);
+
+uint8_t bootloader_hpm_prepare_comp(void);
+uint8_t bootloader_hpm_upload_block(uint8_t *block, uint16_t size);
+uint8_t bootloader_hpm_finish_upload(uint32_t image_size);
+uint8_t bootloader_hpm_activate_firmware(void);
+uint8_t bootloader_hpm_get_upgrade_status(void);
+
+#endif
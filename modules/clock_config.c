@@ -7,7 +7,7 @@ uint8_t clock_config[16];
  *  The configuration is sent as an array in the data field.
  *
 */
-IPMI_HANDLER(ipmi_custom_cmd_write_clock_config, NETFN_CUSTOM, IPMI_CUSTOM_CMD_WRITE_CLOCK_CONFIG, ipmi_msg *req, ipmi_msg *rsp)
+IPMI_REPLAYED_HANDLER(ipmi_custom_cmd_write_clock_config, NETFN_CUSTOM, IPMI_CUSTOM_CMD_WRITE_CLOCK_CONFIG, ipmi_msg *req, ipmi_msg *rsp)
 {
     memcpy(clock_config, req->data, req->data_len);
     payload_send_message(FRU_AMC, PAYLOAD_MESSAGE_CLOCK_CONFIG);
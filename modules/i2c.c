@@ -19,22 +19,82 @@
  *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
  */
 
+/* C Standard includes */
+#include <string.h>
+
 /* Project includes */
 #include "FreeRTOS.h"
+#include "task.h"
 #include "port.h"
 #include "i2c.h"
 #include "i2c_mapping.h"
+#include "task_priorities.h"
 
 #ifdef MODULE_RTM
 #include "rtm_i2c_mapping.h"
 #endif
 
+static void vTaskI2CBus( void * Parameters );
+
 void i2c_init( void )
 {
     for ( uint8_t i = 0; i < I2C_MUX_CNT; i++ ) {
         i2c_mux[i].semaphore = xSemaphoreCreateBinary();
+        i2c_mux[i].queue = xQueueCreate( I2C_QUEUE_DEPTH, sizeof(i2c_transaction_t *) );
         vI2CConfig( i2c_mux[i].i2c_interface, SPEED_100KHZ );
         xSemaphoreGive( i2c_mux[i].semaphore );
+
+        xTaskCreate( vTaskI2CBus, "I2CBus", I2C_BUS_STACK_SIZE, (void *) &i2c_mux[i], tskI2C_BUS_PRIORITY, (TaskHandle_t *) NULL );
+    }
+}
+
+static i2c_mux_state_t * i2c_find_mux( uint8_t i2c_interface )
+{
+    for ( uint8_t i = 0; i < I2C_MUX_CNT; i++ ) {
+        if ( i2c_mux[i].i2c_interface == i2c_interface ) {
+            return &i2c_mux[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Selects the mux channel of a bus, its semaphore being held. The mux is only read when its state isn't trusted, and only
+ * written when the channel changes. On failure, the semaphore has been given back by i2c_set_mux_bus().
+ */
+static bool i2c_mux_select( uint8_t bus_id, i2c_mux_state_t *mux )
+{
+    int8_t channel = i2c_bus_map[bus_id].mux_bus;
+
+    /* This bus is not multiplexed, no action needed */
+    if ( channel == -1 ) {
+        return true;
+    }
+
+    if ( mux->state == I2C_MUX_STATE_UNKNOWN ) {
+        mux->state = i2c_get_mux_bus( bus_id, mux );
+    }
+
+    /* This bus mux is in correct state */
+    if ( mux->state == channel ) {
+        return true;
+    }
+
+    if ( i2c_set_mux_bus( bus_id, mux, channel ) == false ) {
+        mux->state = I2C_MUX_STATE_UNKNOWN;
+        return false;
+    }
+
+    return true;
+}
+
+void i2c_mux_invalidate( uint8_t i2c_interface )
+{
+    i2c_mux_state_t *mux = i2c_find_mux( i2c_interface );
+
+    if ( mux ) {
+        mux->state = I2C_MUX_STATE_UNKNOWN;
     }
 }
 
@@ -66,38 +126,22 @@ bool i2c_take_by_busid( uint8_t bus_id, uint8_t *i2c_interface, TickType_t timeo
         return false;
     }
 
-    /* This bus is not multiplexed, no action needed */
-    if ( p_i2c_bus->mux_bus == -1 ) {
-        *i2c_interface = p_i2c_mux->i2c_interface;
-        portENABLE_INTERRUPTS();
-        return true;
-    }
-
-
-    p_i2c_mux->state = i2c_get_mux_bus( bus_id, p_i2c_mux );
-
-    /* This bus mux is in correct state */
-    if ( p_i2c_mux->state != p_i2c_bus->mux_bus ) {
-        if ( i2c_set_mux_bus( bus_id, p_i2c_mux, p_i2c_bus->mux_bus ) == false ) {
-            return false;
-        }
+    if ( i2c_mux_select( bus_id, p_i2c_mux ) == false ) {
+        return false;
     }
     *i2c_interface = p_i2c_mux->i2c_interface;
     portENABLE_INTERRUPTS();
     return true;
 }
 
-bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t *i2c_interface,  uint32_t timeout )
+bool i2c_get_chip_bus( uint8_t chip_id, uint8_t *bus_id, uint8_t *i2c_address )
 {
-
-    uint8_t bus_id;
-
     /*AFC devices*/
     if (chip_id <= 63) {
         if ( chip_id > I2C_CHIP_CNT ) {
             return false;
         }
-        bus_id = i2c_chip_map[chip_id].bus_id;
+        *bus_id = i2c_chip_map[chip_id].bus_id;
         if ( i2c_address != NULL ) {
             *i2c_address = i2c_chip_map[chip_id].i2c_address;
         }
@@ -108,7 +152,7 @@ bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t *i2c_int
         if ( chip_id > 64+I2C_CHIP_RTM_CNT ) {
             return false;
         }
-        bus_id = i2c_chip_rtm_map[chip_id-64].bus_id;
+        *bus_id = i2c_chip_rtm_map[chip_id-64].bus_id;
         if ( i2c_address != NULL ) {
             *i2c_address = i2c_chip_rtm_map[chip_id-64].i2c_address;
         }
@@ -118,9 +162,210 @@ bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t *i2c_int
         return false;
     }
 
+    return true;
+}
+
+bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t *i2c_interface,  uint32_t timeout )
+{
+    uint8_t bus_id;
+
+    if ( !i2c_get_chip_bus( chip_id, &bus_id, i2c_address ) ) {
+        return false;
+    }
+
     return i2c_take_by_busid( bus_id, i2c_interface, timeout );
 }
 
+static void i2c_bus_run( i2c_mux_state_t * mux, i2c_transaction_t * transaction );
+static void i2c_bus_complete( i2c_transaction_t * transaction );
+
+mmc_err i2c_submit( i2c_transaction_t * transaction )
+{
+    i2c_mux_state_t *mux;
+
+    if ( !i2c_get_chip_bus( transaction->chip_id, &transaction->bus_id, &transaction->i2c_address ) ) {
+        return MMC_INVALID_ARG_ERR;
+    }
+
+    mux = i2c_find_mux( i2c_bus_map[transaction->bus_id].i2c_interface );
+
+    if ( ( mux == NULL ) || ( mux->queue == NULL ) || ( i2c_bus_map[transaction->bus_id].enabled == 0 ) ) {
+        return MMC_INVALID_ARG_ERR;
+    }
+
+    /* The bus tasks aren't running yet (e.g. FRU EEPROM read during the initialization), the caller is the bus owner */
+    if ( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING ) {
+        if ( xSemaphoreTake( mux->semaphore, 0 ) == pdFALSE ) {
+            return MMC_RESOURCE_ERR;
+        }
+        i2c_bus_run( mux, transaction );
+        xSemaphoreGive( mux->semaphore );
+
+        i2c_bus_complete( transaction );
+        return MMC_OK;
+    }
+
+    if ( xQueueSend( mux->queue, &transaction, 0 ) != pdTRUE ) {
+        return MMC_RESOURCE_ERR;
+    }
+
+    return MMC_OK;
+}
+
+mmc_err i2c_transact( i2c_transaction_t * transaction )
+{
+    mmc_err err;
+
+    configASSERT( transaction->done );
+
+    err = i2c_submit( transaction );
+
+    if ( err != MMC_OK ) {
+        return err;
+    }
+
+    /* The bus task owns the buffers until it's done, so there is no giving up here. Before the scheduler is started, the
+     * transaction already ran and the semaphore is given. */
+    xSemaphoreTake( transaction->done, portMAX_DELAY );
+
+    return transaction->status;
+}
+
+/**
+ * @brief Runs a transaction, the bus semaphore being held
+ */
+static void i2c_bus_run( i2c_mux_state_t * mux, i2c_transaction_t * transaction )
+{
+    int rx_count = 0;
+
+    if ( !i2c_mux_select( transaction->bus_id, mux ) ) {
+        /* The mux setting gives the semaphore back when it fails, get it again for the next transactions */
+        xSemaphoreTake( mux->semaphore, portMAX_DELAY );
+        transaction->status = MMC_RESOURCE_ERR;
+        transaction->rx_count = 0;
+        return;
+    }
+
+    if ( xI2CMasterWriteReadStatus( mux->i2c_interface, transaction->i2c_address, transaction->tx_buff, transaction->tx_len,
+                                    transaction->rx_buff, transaction->rx_len, &rx_count ) == I2C_STATUS_DONE ) {
+        transaction->status = MMC_OK;
+    } else {
+        /* A failed transfer makes the port forget the mux channel */
+        transaction->status = MMC_IO_ERR;
+    }
+    transaction->rx_count = rx_count;
+}
+
+/**
+ * @brief Notifies the submitter that a transaction is over
+ */
+static void i2c_bus_complete( i2c_transaction_t * transaction )
+{
+    if ( transaction->done ) {
+        xSemaphoreGive( transaction->done );
+    }
+    if ( transaction->callback ) {
+        transaction->callback( transaction );
+    }
+}
+
+/**
+ * @brief Bus task, runs the queued transactions of a physical bus
+ *
+ * The bus semaphore is taken once for all the transactions queued at that time, so they run back to back.
+ *
+ * @param Parameters Bus mux state (#i2c_mux_state_t)
+ */
+static void vTaskI2CBus( void * Parameters )
+{
+    i2c_mux_state_t *mux = (i2c_mux_state_t *) Parameters;
+    i2c_transaction_t *transaction;
+
+    for ( ;; ) {
+        xQueueReceive( mux->queue, &transaction, portMAX_DELAY );
+
+        xSemaphoreTake( mux->semaphore, portMAX_DELAY );
+
+        do {
+            i2c_bus_run( mux, transaction );
+            i2c_bus_complete( transaction );
+        } while ( xQueueReceive( mux->queue, &transaction, 0 ) == pdTRUE );
+
+        xSemaphoreGive( mux->semaphore );
+    }
+}
+
+/*
+ * Runs a batch operation, the bus semaphore being held and the chip's mux channel selected
+ */
+static mmc_err i2c_op_run( uint8_t i2c_interface, uint8_t i2c_address, i2c_op_t * op )
+{
+    uint8_t tx[1 + I2C_OP_MAX_WRITE];
+
+    if ( op->flags & I2C_OP_READ ) {
+        if ( xI2CMasterWriteReadStatus( i2c_interface, i2c_address, &op->reg, ( op->flags & I2C_OP_REG ) ? 1 : 0,
+                                        op->data, op->len, NULL ) != I2C_STATUS_DONE ) {
+            return MMC_IO_ERR;
+        }
+        return MMC_OK;
+    }
+
+    if ( !( op->flags & I2C_OP_REG ) ) {
+        return ( xI2CMasterWriteReadStatus( i2c_interface, i2c_address, op->data, op->len, NULL, 0, NULL ) == I2C_STATUS_DONE ) ? MMC_OK : MMC_IO_ERR;
+    }
+
+    /* The register address goes in the same write */
+    tx[0] = op->reg;
+    memcpy( &tx[1], op->data, op->len );
+
+    return ( xI2CMasterWriteReadStatus( i2c_interface, i2c_address, tx, op->len + 1, NULL, 0, NULL ) == I2C_STATUS_DONE ) ? MMC_OK : MMC_IO_ERR;
+}
+
+mmc_err i2c_batch( i2c_op_t * ops, uint8_t count, TickType_t timeout )
+{
+    i2c_mux_state_t *mux;
+    mmc_err err = MMC_OK;
+    uint8_t bus_id, i2c_address, i2c_interface;
+    uint8_t i;
+
+    if ( count == 0 ) {
+        return MMC_OK;
+    }
+
+    if ( !i2c_get_chip_bus( ops[0].chip_id, &bus_id, NULL ) || !i2c_take_by_busid( bus_id, &i2c_interface, timeout ) ) {
+        for ( i = 0; i < count; i++ ) {
+            ops[i].status = MMC_TIMEOUT_ERR;
+        }
+        return MMC_TIMEOUT_ERR;
+    }
+
+    mux = i2c_find_mux( i2c_interface );
+
+    for ( i = 0; i < count; i++ ) {
+        if ( !i2c_get_chip_bus( ops[i].chip_id, &bus_id, &i2c_address ) || ( i2c_bus_map[bus_id].i2c_interface != i2c_interface ) ||
+             ( ( ops[i].flags & I2C_OP_REG ) && !( ops[i].flags & I2C_OP_READ ) && ( ops[i].len > I2C_OP_MAX_WRITE ) ) ) {
+            ops[i].status = MMC_INVALID_ARG_ERR;
+        } else if ( !i2c_mux_select( bus_id, mux ) ) {
+            /* The semaphore was given back, the remaining operations don't run */
+            for ( ; i < count; i++ ) {
+                ops[i].status = MMC_RESOURCE_ERR;
+            }
+            return ( err == MMC_OK ) ? MMC_RESOURCE_ERR : err;
+        } else {
+            /* A failed transfer makes the port forget the mux channel */
+            ops[i].status = i2c_op_run( i2c_interface, i2c_address, &ops[i] );
+        }
+
+        if ( ( err == MMC_OK ) && ( ops[i].status != MMC_OK ) ) {
+            err = ops[i].status;
+        }
+    }
+
+    i2c_give( i2c_interface );
+
+    return err;
+}
+
 void i2c_give( uint8_t i2c_interface )
 {
     i2c_mux_state_t *mux;
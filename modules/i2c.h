@@ -24,9 +24,21 @@
 
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "queue.h"
+#include "mmc_error.h"
 #include <stdint.h>
 #include <stdbool.h>
 
+/**
+ * @brief Transactions waiting to be run on each physical I2C bus
+ */
+#define I2C_QUEUE_DEPTH                 8
+
+/**
+ * @brief Stack depth of the bus tasks (in words), the transaction callbacks run on it
+ */
+#define I2C_BUS_STACK_SIZE              160
+
 /**
  * @brief I2C Chips information regarding the bus and slave address
  */
@@ -46,15 +58,78 @@ typedef struct i2c_bus_mapping {
     uint8_t enabled;                /**< Enabled flag */
 } i2c_bus_mapping_t;
 
+/**
+ * @brief Mux state value telling the channel has to be read back from the mux before it is trusted
+ */
+#define I2C_MUX_STATE_UNKNOWN           (-1)
+
 /**
  * @brief I2C Mux state
+ *
+ * The state is the last channel programmed in the mux. It is trusted as long as the bus is only driven by us: it goes back to
+ * #I2C_MUX_STATE_UNKNOWN when a mux setting or a transaction fails, when the arbitration is lost (another master is on the bus)
+ * and on #i2c_mux_invalidate. The port master transfer functions call #i2c_mux_invalidate themselves on each of these events.
  */
 typedef struct i2c_mux_state {
     uint8_t i2c_interface;         /**< Physical I2C bus number */
     int8_t state;                   /**< Mux state */
     SemaphoreHandle_t semaphore;    /**< Bus semaphore handle */
+    QueueHandle_t queue;            /**< Transactions waiting for the bus task (see #i2c_submit) */
 } i2c_mux_state_t;
 
+/**
+ * @brief Batch operation flags (see #i2c_op_t)
+ */
+#define I2C_OP_WRITE                    0x00    /**< Write the data bytes */
+#define I2C_OP_READ                     0x01    /**< Read the data bytes */
+#define I2C_OP_REG                      0x02    /**< Send the register address first (after it, a read uses a repeated start) */
+
+/**
+ * @brief Largest write of a batch operation sending a register address, register byte excluded
+ */
+#define I2C_OP_MAX_WRITE                8
+
+/**
+ * @brief I2C batch operation, a register read or write on a chip (see #i2c_batch)
+ */
+typedef struct i2c_op {
+    uint8_t chip_id;                /**< Chip to talk to */
+    uint8_t flags;                  /**< I2C_OP_* flags */
+    uint8_t reg;                    /**< Register address, sent if I2C_OP_REG is set */
+    uint8_t * data;                 /**< Bytes to write, or buffer receiving the bytes read */
+    uint8_t len;                    /**< Amount of data bytes */
+    mmc_err status;                 /**< Result of the operation */
+} i2c_op_t;
+
+typedef struct i2c_transaction i2c_transaction_t;
+
+/**
+ * @brief I2C transaction completion callback, called from the bus task (or from the submitter before the scheduler is started)
+ */
+typedef void (* i2c_transaction_cb_t)( i2c_transaction_t * transaction );
+
+/**
+ * @brief I2C transaction descriptor
+ *
+ * A write of tx_len bytes, followed by a read of rx_len bytes after a repeated start. Either part may be empty. The
+ * descriptor and its buffers belong to the bus task from #i2c_submit until its completion is notified.
+ */
+struct i2c_transaction {
+    uint8_t chip_id;                /**< Chip to talk to */
+    const uint8_t * tx_buff;        /**< Bytes to write */
+    uint8_t tx_len;                 /**< Amount of bytes to write */
+    uint8_t * rx_buff;              /**< Buffer receiving the bytes read */
+    uint8_t rx_len;                 /**< Amount of bytes to read */
+    SemaphoreHandle_t done;         /**< Binary semaphore given once the transaction is over (may be NULL) */
+    i2c_transaction_cb_t callback;  /**< Called from the bus task once the transaction is over (may be NULL) */
+    void * arg;                     /**< Free for the submitter */
+    mmc_err status;                 /**< Result: MMC_OK, MMC_IO_ERR if not all bytes were transferred, MMC_RESOURCE_ERR if the
+                                     *   bus could not be selected */
+    uint8_t rx_count;               /**< Amount of bytes actually read */
+    uint8_t bus_id;                 /**< Filled by #i2c_submit */
+    uint8_t i2c_address;            /**< Filled by #i2c_submit */
+};
+
 /**
  * @brief Initialize peripheral I2C buses
  *
@@ -80,9 +155,18 @@ bool i2c_set_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux, int8_t new_state
  * @param bus_id Target bus ID
  * @param i2c_mux Pointer to bus mux structure
  *
- * @return Bus current state
+ * @return Bus current state, #I2C_MUX_STATE_UNKNOWN if the mux could not be read or has no channel enabled
  */
-uint8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux );
+int8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux );
+
+/**
+ * @brief Forget the mux channel of an I2C bus, it is read back from the mux on the next access
+ *
+ * To be called when the mux may have been switched behind our back (another master on the bus, failed transfer, mux reset).
+ *
+ * @param i2c_interface Physical I2C bus ID
+ */
+void i2c_mux_invalidate( uint8_t i2c_interface );
 
 /**
  * @brief Take control over an I2C bus given a bus id
@@ -96,6 +180,18 @@ uint8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux );
  */
 bool i2c_take_by_busid( uint8_t bus_id, uint8_t *i2c_interface, uint32_t timeout );
 
+/**
+ * @brief Find the bus and slave address of a chip, without taking the bus
+ *
+ * @param[in] chip_id Chip ID to look up
+ * @param[out] bus_id Pointer to variable that will hold the chip bus ID
+ * @param[out] i2c_address Pointer to variable that will hold the chip slave address (may be NULL)
+ *
+ * @retval true Chip found in the mapping tables
+ * @retval false Unknown chip ID
+ */
+bool i2c_get_chip_bus( uint8_t chip_id, uint8_t *bus_id, uint8_t *i2c_address );
+
 /**
  * @brief Take control over an I2C bus given a chip id
  *
@@ -116,4 +212,51 @@ bool i2c_take_by_chipid( uint8_t chip_id, uint8_t *i2c_address, uint8_t * i2c_in
  */
 void i2c_give( uint8_t i2c_interface );
 
+/**
+ * @brief Run a list of register operations under a single bus acquisition
+ *
+ * The operations run in order from the calling task, the bus semaphore being taken once for all of them. They may target
+ * different chips, as long as they sit on the same physical bus: the mux channel is only changed between operations on
+ * different mux branches. It can be used before the scheduler is started.
+ *
+ * It is meant for registers that are accessed together (e.g. configuring an ADC channel and reading it back), a single
+ * register access simply uses #i2c_take_by_chipid.
+ *
+ * @param ops Operations, each one gets its own status (MMC_INVALID_ARG_ERR for a chip on another bus or a too long write)
+ * @param count Amount of operations
+ * @param timeout Maximum time to wait for the bus
+ *
+ * @retval MMC_OK All operations succeeded
+ * @retval MMC_TIMEOUT_ERR The bus could not be taken, none of the operations ran
+ * @return Otherwise the status of the first failed operation
+ */
+mmc_err i2c_batch( i2c_op_t * ops, uint8_t count, TickType_t timeout );
+
+/**
+ * @brief Queue a transaction on the bus of its chip
+ *
+ * Each physical bus has a task running its queued transactions back to back, holding the bus semaphore (so the users of
+ * #i2c_take_by_chipid still get the bus in between) and selecting the mux channel of each chip. Once a transaction is over,
+ * its done semaphore is given and its callback called.
+ *
+ * Before the scheduler is started, there is nobody else on the bus: the transaction runs right away from the caller, and
+ * is over (done semaphore given, callback called) when this function returns.
+ *
+ * @param transaction Transaction descriptor, must stay valid until the transaction is over
+ *
+ * @retval MMC_OK Transaction queued
+ * @retval MMC_INVALID_ARG_ERR Unknown chip ID or disabled bus
+ * @retval MMC_RESOURCE_ERR Queue full, or bus already taken before the scheduler is started
+ */
+mmc_err i2c_submit( i2c_transaction_t * transaction );
+
+/**
+ * @brief Run a transaction and wait for it to be over
+ *
+ * @param transaction Transaction descriptor, its done semaphore must be set
+ *
+ * @return #i2c_submit error, or the transaction status
+ */
+mmc_err i2c_transact( i2c_transaction_t * transaction );
+
 #endif
@@ -27,6 +27,7 @@
 
 /* C Standard includes */
 #include "string.h"
+#include <stddef.h>
 
 /* Project includes */
 #include "utils.h"
@@ -75,15 +76,14 @@ ipmb_error ipmb_encode ( uint8_t * buffer, ipmi_msg * msg );
 ipmb_error ipmb_decode ( ipmi_msg * msg, uint8_t * buffer, uint8_t len );
 
 /**
- * @brief Notifies the client that a new request has arrived and copies the message to its queue.
- * This function receives a message wrapped in a ipmi_msg_cfg struct and copies only the ipmi_msg
- * field to the client queue.
+ * @brief Notifies the client that a new request has arrived and passes the message buffer to its queue.
+ * Only the buffer pointer is queued, the client takes its ownership and must release it with #ipmb_msg_free.
  * Also, if a task has registered its handle in the caller_task field, notify it.
  *
  * @param[in] msg_cfg The message that arrived, wrapped in the configuration struct ipmi_msg_cfg.
  *
- * @retval ipmb_error_success The message was successfully copied.
- * @retval ipmb_error_timeout The client_queue was full.
+ * @retval ipmb_error_success The message was successfully queued.
+ * @retval ipmb_error_timeout The client_queue was full, the buffer was released.
  */
 ipmb_error ipmb_notify_client ( ipmi_msg_cfg * msg_cfg );
 
@@ -91,165 +91,442 @@ ipmb_error ipmb_notify_client ( ipmi_msg_cfg * msg_cfg );
 uint8_t ipmb_addr = 0xFF;
 
 QueueHandle_t ipmb_txqueue = NULL;
+QueueHandle_t ipmb_rxqueue = NULL;
 QueueHandle_t client_queue = NULL;
 
 static uint8_t current_seq;
-static ipmi_msg_cfg *last_sent_req;
+
+/**
+ * @brief Statically allocated IPMB message buffers
+ */
+static ipmi_msg_cfg ipmb_msg_pool[IPMB_MSG_POOL_SIZE];
+
+/* Free bits of the bitmap word w, for the buffers 32*w to 32*w+31 */
+#define IPMB_MSG_POOL_WORD_INIT(w)  ( ( IPMB_MSG_POOL_SIZE >= 32 * ( (w) + 1 ) ) ? 0xFFFFFFFFUL : \
+                                      ( IPMB_MSG_POOL_SIZE > 32 * (w) ) ? ( ( 1UL << ( IPMB_MSG_POOL_SIZE - 32 * (w) ) ) - 1 ) : 0 )
+
+/**
+ * @brief Free buffers bitmap (bit n of word w set means ipmb_msg_pool[32*w+n] is available)
+ */
+static uint32_t ipmb_msg_pool_free[IPMB_MSG_POOL_WORDS] = {
+    IPMB_MSG_POOL_WORD_INIT(0),
+#if IPMB_MSG_POOL_WORDS > 1
+    IPMB_MSG_POOL_WORD_INIT(1),
+#endif
+};
+
+static ipmb_pool_stats pool_stats;
+
+static ipmb_link_stats link_stats;
+
+/**
+ * @brief Adds a sample to a log2 latency histogram
+ *
+ * @param hist Histogram bins (#IPMB_HIST_BINS entries)
+ * @param ticks Sample value
+ */
+static void ipmb_hist_add( uint16_t * hist, TickType_t ticks )
+{
+    uint8_t bin = ( ticks == 0 ) ? 0 : ( 32 - __builtin_clz( ticks ) );
+
+    if ( bin >= IPMB_HIST_BINS ) {
+        bin = IPMB_HIST_BINS - 1;
+    }
+
+    /* Saturate instead of wrapping around */
+    if ( hist[bin] < UINT16_MAX ) {
+        hist[bin]++;
+    }
+}
+
+/**
+ * @brief Outstanding requests, indexed by sequence number
+ */
+static ipmb_pending_req pending_req[IPMB_SEQ_COUNT];
+
+/**
+ * @brief Reserves a sequence number for a new request
+ *
+ * Starting from the last used value, looks for a sequence number which is not held by an outstanding request (entries are released
+ * by the requester itself, once the response arrives or times out). The entry is marked as queued and filled with the request fields
+ * needed to match the response.
+ *
+ * @param[in,out] req Request message, its seq field is written by this function
+ *
+ * @retval true A sequence number was reserved
+ * @retval false All sequence numbers are in use
+ */
+static bool ipmb_alloc_seq( ipmi_msg * req )
+{
+    ipmb_pending_req *entry;
+    bool found = false;
+
+    taskENTER_CRITICAL();
+    for ( uint8_t i = 0; i < IPMB_SEQ_COUNT; i++ ) {
+        entry = &pending_req[current_seq];
+
+        if ( entry->state == IPMB_REQ_FREE ) {
+            entry->state = IPMB_REQ_QUEUED;
+            entry->netfn = req->netfn;
+            entry->cmd = req->cmd;
+            entry->dest_addr = req->dest_addr;
+            entry->caller_task = xTaskGetCurrentTaskHandle();
+            req->seq = current_seq;
+            found = true;
+        }
+
+        current_seq = ( current_seq + 1 ) % IPMB_SEQ_COUNT;
+
+        if ( found ) {
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return found;
+}
+
+/**
+ * @brief Updates the pending request entry after a transmission attempt
+ *
+ * @param seq Sequence number of the request
+ * @param sent True if the request reached the bus, false if it was dropped
+ */
+static void ipmb_update_seq( uint8_t seq, bool sent )
+{
+    taskENTER_CRITICAL();
+    if ( sent ) {
+        pending_req[seq].timestamp = xTaskGetTickCount();
+        pending_req[seq].state = IPMB_REQ_SENT;
+    } else {
+        pending_req[seq].state = IPMB_REQ_FREE;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Messages backing off before their next transmission attempt
+ */
+static ipmb_tx_backoff tx_backoff[IPMB_TX_BACKOFF_LEN];
+
+/**
+ * @brief Backoff pseudo-random generator state
+ */
+static uint32_t tx_rand_state;
+
+/**
+ * @brief Xorshift pseudo-random generator, good enough to spread the retries of colliding controllers
+ */
+static uint32_t ipmb_tx_rand( void )
+{
+    tx_rand_state ^= tx_rand_state << 13;
+    tx_rand_state ^= tx_rand_state >> 17;
+    tx_rand_state ^= tx_rand_state << 5;
+    return tx_rand_state;
+}
+
+/**
+ * @brief Draws the delay before the next attempt of a message
+ *
+ * @param attempt Number of failed attempts so far (1 for the first retry)
+ *
+ * @return Random delay in the [1, window] ticks range, the window doubling on every attempt up to #IPMB_TX_BACKOFF_MAX
+ */
+static TickType_t ipmb_tx_backoff_delay( uint8_t attempt )
+{
+    TickType_t window = IPMB_TX_BACKOFF_BASE << ( ( attempt < 8 ) ? ( attempt - 1 ) : 7 );
+
+    if ( window > IPMB_TX_BACKOFF_MAX ) {
+        window = IPMB_TX_BACKOFF_MAX;
+    }
+
+    if ( window == 0 ) {
+        window = 1;
+    }
+
+    return 1 + ( ipmb_tx_rand() % window );
+}
+
+/**
+ * @brief Looks for the backoff slot that should be retried next
+ *
+ * @param[in] now Current tick count
+ * @param[out] wait Ticks until the next message leaves the backoff (portMAX_DELAY if there's none)
+ * @param[out] free_slot Set to a free slot index, or -1 if the list is full
+ *
+ * @return Index of the ready slot holding the oldest message (responses are preferred) or -1 if no message is ready
+ */
+static int8_t ipmb_tx_backoff_ready( TickType_t now, TickType_t * wait, int8_t * free_slot )
+{
+    int8_t ready = -1;
+    TickType_t elapsed;
+
+    *wait = portMAX_DELAY;
+    *free_slot = -1;
+
+    for ( int8_t i = 0; i < IPMB_TX_BACKOFF_LEN; i++ ) {
+        if ( tx_backoff[i].msg == NULL ) {
+            *free_slot = i;
+            continue;
+        }
+
+        elapsed = now - tx_backoff[i].start;
+        if ( elapsed < tx_backoff[i].delay ) {
+            if ( ( tx_backoff[i].delay - elapsed ) < *wait ) {
+                *wait = tx_backoff[i].delay - elapsed;
+            }
+            continue;
+        }
+
+        if ( ready < 0 ) {
+            ready = i;
+        } else if ( IS_RESPONSE( tx_backoff[i].msg->buffer ) != IS_RESPONSE( tx_backoff[ready].msg->buffer ) ) {
+            if ( IS_RESPONSE( tx_backoff[i].msg->buffer ) ) {
+                ready = i;
+            }
+        } else if ( (int32_t) ( tx_backoff[i].msg->timestamp - tx_backoff[ready].msg->timestamp ) < 0 ) {
+            /* Queued earlier, it has been waiting longer */
+            ready = i;
+        }
+    }
+
+    return ready;
+}
+
+/**
+ * @brief Finishes the transmission of a message, notifying its sender and releasing the buffer
+ *
+ * @param msg Message buffer
+ * @param sent True if the message reached the bus, false if it was dropped
+ */
+static void ipmb_tx_done( ipmi_msg_cfg * msg, bool sent )
+{
+    if ( IS_RESPONSE( msg->buffer ) ) {
+        if ( sent ) {
+            link_stats.tx_responses++;
+        }
+    } else {
+        if ( sent ) {
+            link_stats.tx_requests++;
+        }
+        /* A sent request pending entry now waits for the response, a dropped one gives the sequence number back */
+        ipmb_update_seq( msg->buffer.seq, sent );
+    }
+
+    if ( !sent ) {
+        link_stats.tx_failures++;
+    }
+
+    xTaskNotify( msg->caller_task, sent ? ipmb_error_success : ipmb_error_failure, eSetValueWithOverwrite );
+    /* Free the message buffer */
+    ipmb_msg_free( msg );
+}
 
 void IPMB_TXTask ( void * pvParameters )
 {
     ipmi_msg_cfg *current_msg_tx;
     uint8_t ipmb_buffer_tx[IPMI_MSG_MAX_LENGTH];
+    uint8_t tx_size;
+    I2C_STATUS_T status;
+    TickType_t now;
+    TickType_t wait;
+    int8_t ready;
+    int8_t free_slot;
+    bool exhausted;
+
+    /* Each controller has a different address, so colliding controllers draw different delays */
+    tx_rand_state = ( ( uint32_t ) ipmb_addr << 24 ) ^ xTaskGetTickCount() ^ 0x2545F491;
 
     for ( ;; ) {
-        xQueueReceive( ipmb_txqueue, &current_msg_tx, portMAX_DELAY);
-
-        if ( IS_RESPONSE(current_msg_tx->buffer) ) {
-            /* We're sending a response */
-
-            /**********************************/
-            /*       Error checking           */
-            /**********************************/
-
-            /* See if we've already tried sending this message 3 times */
-            if ( current_msg_tx->retries > IPMB_MAX_RETRIES ) {
-                xTaskNotify( current_msg_tx->caller_task ,ipmb_error_failure , eSetValueWithOverwrite);
-                /* Free the message buffer */
-                vPortFree( current_msg_tx );
-                current_msg_tx = NULL;
-                continue;
-            }
+        current_msg_tx = NULL;
+        now = xTaskGetTickCount();
+        ready = ipmb_tx_backoff_ready( now, &wait, &free_slot );
 
-            /**********************************/
-            /*     Try sending the message    */
-            /**********************************/
-
-            /* Encode the message buffer to the IPMB format */
-            ipmb_encode( &ipmb_buffer_tx[0], &current_msg_tx->buffer );
-            uint8_t resp_tx_size = current_msg_tx->buffer.data_len + IPMB_RESP_HEADER_LENGTH;
-            if ( xI2CMasterWrite( IPMB_I2C, current_msg_tx->buffer.dest_addr >> 1, &ipmb_buffer_tx[1], resp_tx_size ) < resp_tx_size ) {
-                /* Message couldn't be transmitted right now, increase retry counter and try again later */
-                current_msg_tx->retries++;
-                xQueueSendToFront( ipmb_txqueue, &current_msg_tx, 0 );
-
-            } else {
-                /* Success case*/
-                xTaskNotify( current_msg_tx->caller_task , ipmb_error_success, eSetValueWithOverwrite);
-                /* Free the message buffer */
-                vPortFree( current_msg_tx );
-                current_msg_tx = NULL;
-            }
+        if ( ( ready >= 0 ) && IS_RESPONSE( tx_backoff[ready].msg->buffer ) ) {
+            /* A response is ready to be retried, its requester is waiting on a short timeout */
+            current_msg_tx = tx_backoff[ready].msg;
+            tx_backoff[ready].msg = NULL;
 
-        } else {
+        } else if ( ( free_slot >= 0 ) &&
+                    ( xQueueReceive( ipmb_txqueue, &current_msg_tx, ( ready >= 0 ) ? 0 : wait ) == pdTRUE ) ) {
+            /* New message, only taken while there's room to park it if the first attempt fails */
+            ipmb_hist_add( link_stats.tx_wait_hist, xTaskGetTickCount() - current_msg_tx->timestamp );
 
-            /***************************************/
-            /* Sending new outgoing request        */
-            /***************************************/
+        } else if ( ready >= 0 ) {
+            /* Nothing new to send, retry the request which is waiting the longest */
+            current_msg_tx = tx_backoff[ready].msg;
+            tx_backoff[ready].msg = NULL;
 
-            /* Get the time when the message is first sent */
-            if ( current_msg_tx->retries == 0 ) {
-                current_msg_tx->timestamp = xTaskGetTickCount();
+        } else {
+            if ( free_slot < 0 ) {
+                /* Backoff list is full and nothing is ready yet */
+                vTaskDelay( wait );
             }
+            continue;
+        }
 
-            ipmb_encode( &ipmb_buffer_tx[0], &current_msg_tx->buffer );
-            uint8_t req_tx_size = current_msg_tx->buffer.data_len + IPMB_REQ_HEADER_LENGTH;
-            if ( xI2CMasterWrite( IPMB_I2C, current_msg_tx->buffer.dest_addr >> 1, &ipmb_buffer_tx[1], req_tx_size ) < req_tx_size) {
-
-                current_msg_tx->retries++;
-
-                if ( current_msg_tx->retries > IPMB_MAX_RETRIES ){
-                    xTaskNotify ( current_msg_tx->caller_task, ipmb_error_failure, eSetValueWithOverwrite);
-                    /* Free the message buffer */
-                    vPortFree( current_msg_tx );
-                    current_msg_tx = NULL;
-                } else {
-                    xQueueSendToFront( ipmb_txqueue, &current_msg_tx, 0 );
-                }
-
-            } else {
-                /* Request was successfully sent, keep a copy here for future comparison and clean the last used buffer */
-                vPortFree( last_sent_req );
-                last_sent_req = current_msg_tx;
-                xTaskNotify ( current_msg_tx->caller_task, ipmb_error_success, eSetValueWithOverwrite);
-            }
+        /* Encode the message buffer to the IPMB format */
+        ipmb_encode( &ipmb_buffer_tx[0], &current_msg_tx->buffer );
+        tx_size = current_msg_tx->buffer.data_len + ( IS_RESPONSE( current_msg_tx->buffer ) ? IPMB_RESP_HEADER_LENGTH : IPMB_REQ_HEADER_LENGTH );
+
+        status = xI2CMasterWriteStatus( IPMB_I2C, current_msg_tx->buffer.dest_addr >> 1, &ipmb_buffer_tx[1], tx_size );
+
+        if ( status == I2C_STATUS_DONE ) {
+            ipmb_tx_done( current_msg_tx, true );
+            continue;
+        }
+
+        if ( status == I2C_STATUS_ARBLOST ) {
+            /* Another controller won the bus, it isn't an error of our message */
+            link_stats.tx_arb_lost++;
+            current_msg_tx->arb_lost++;
+            exhausted = ( current_msg_tx->arb_lost > IPMB_MAX_ARB_LOST );
+        } else {
+            current_msg_tx->retries++;
+            exhausted = ( current_msg_tx->retries > ( IS_RESPONSE( current_msg_tx->buffer ) ? IPMB_MAX_RESP_RETRIES : IPMB_MAX_REQ_RETRIES ) );
+        }
+
+        if ( exhausted ) {
+            ipmb_tx_done( current_msg_tx, false );
+            continue;
         }
+
+        /* Message couldn't be transmitted right now, back off and let the other messages go first */
+        link_stats.tx_retries++;
+        ipmb_tx_backoff_ready( now, &wait, &free_slot );
+        configASSERT( free_slot >= 0 );
+        tx_backoff[free_slot].msg = current_msg_tx;
+        tx_backoff[free_slot].start = xTaskGetTickCount();
+        tx_backoff[free_slot].delay = ipmb_tx_backoff_delay( current_msg_tx->retries + current_msg_tx->arb_lost );
     }
 }
 
-void IPMB_RXTask ( void *pvParameters )
+/**
+ * @brief I2C slave receive callback (runs in interrupt context)
+ *
+ * The slave driver writes each frame directly into the frame field of a pool buffer. When the transfer is done the filled buffer is queued to
+ * #IPMB_RXTask and a fresh one is armed. If no buffer is available or the RX queue is full, the frame is dropped and the same buffer is
+ * reused, the requester will retry.
+ *
+ * @param rx_buff Start of the received bytes (points to the frame field of a pool buffer, just after the address byte)
+ * @param rx_len Amount of bytes received
+ * @param pxHigherPriorityTaskWoken Set to pdTRUE if the RX task was unblocked
+ *
+ * @return Buffer which will receive the next frame
+ */
+static uint8_t * ipmb_slave_rx( uint8_t * rx_buff, uint8_t rx_len, BaseType_t * pxHigherPriorityTaskWoken )
 {
-    ipmi_msg_cfg *current_msg_rx;
-    uint8_t ipmb_buffer_rx[IPMI_MSG_MAX_LENGTH];
-    uint8_t rx_len;
+    ipmi_msg_cfg *msg_cfg = (ipmi_msg_cfg *) ( rx_buff - 1 - offsetof( ipmi_msg_cfg, frame ) );
+    ipmi_msg_cfg *next;
 
-    for ( ;; ) {
-        /* Checks if there's any incoming messages (the task remains blocked here) */
-        rx_len = xI2CSlaveReceive( IPMB_I2C, &ipmb_buffer_rx[1], IPMI_MSG_MAX_LENGTH - 1, portMAX_DELAY );
+    if ( rx_len == 0 ) {
+        return rx_buff;
+    }
 
-        if ( rx_len > 0 ) {
+    next = ipmb_msg_alloc();
 
-            ipmb_buffer_rx[0] = ipmb_addr;
-            rx_len++;
+    if ( next == NULL ) {
+        link_stats.rx_dropped++;
+        return rx_buff;
+    }
 
-            /* Perform a checksum test on the message, if it doesn't pass, just ignore it.
-             * Following the IPMB specs, we have no way to know if we're the one who should
-             * receive it. In MicroTCA crates with star topology for IPMB, we are assured we
-             * are the recipients, however, malformed messages may be safely ignored as the
-             * MCMC should take care of retrying.
-             */
+    /* Account for the address byte, which isn't transmitted */
+    msg_cfg->frame_len = rx_len + 1;
 
-            if ( ipmb_assert_chksum( ipmb_buffer_rx, rx_len ) != ipmb_error_success ) {
-                continue;
-            }
+    if ( xQueueSendFromISR( ipmb_rxqueue, &msg_cfg, pxHigherPriorityTaskWoken ) != pdTRUE ) {
+        link_stats.rx_dropped++;
+        ipmb_msg_free( next );
+        return rx_buff;
+    }
 
-            current_msg_rx = pvPortMalloc(sizeof(ipmi_msg_cfg));
+    return &next->frame[1];
+}
 
-            /* Clear our local buffer before writing new data into it */
-            memset(current_msg_rx, 0, sizeof(ipmi_msg_cfg));
+void IPMB_RXTask ( void *pvParameters )
+{
+    ipmi_msg_cfg *current_msg_rx;
+
+    for ( ;; ) {
+        /* Checks if there's any incoming messages (the task remains blocked here) */
+        xQueueReceive( ipmb_rxqueue, &current_msg_rx, portMAX_DELAY );
+
+        current_msg_rx->frame[0] = ipmb_addr;
+        link_stats.rx_frames++;
+
+        /* Perform a checksum test on the message, if it doesn't pass, just ignore it.
+         * Following the IPMB specs, we have no way to know if we're the one who should
+         * receive it. In MicroTCA crates with star topology for IPMB, we are assured we
+         * are the recipients, however, malformed messages may be safely ignored as the
+         * MCMC should take care of retrying.
+         */
+
+        switch ( ipmb_assert_chksum( current_msg_rx->frame, current_msg_rx->frame_len ) ) {
+        case ipmb_error_success:
+            break;
+        case ipmb_error_hdr_chksum:
+            link_stats.rx_hdr_chksum_err++;
+            ipmb_msg_free( current_msg_rx );
+            continue;
+        default:
+            link_stats.rx_msg_chksum_err++;
+            ipmb_msg_free( current_msg_rx );
+            continue;
+        }
 
-            ipmb_decode( &(current_msg_rx->buffer), ipmb_buffer_rx, rx_len );
+        current_msg_rx->caller_task = NULL;
+        current_msg_rx->retries = 0;
+        current_msg_rx->arb_lost = 0;
 
-            if ( IS_RESPONSE( current_msg_rx->buffer ) ) {
-                /* The message is a response, check if it's been received in time */
-                if ( (xTaskGetTickCount() - last_sent_req->timestamp) < IPMB_MSG_TIMEOUT ) {
-                    /* Seq number checking is enough to match the messages */
-                    if ( current_msg_rx->buffer.seq == last_sent_req->buffer.seq ) {
-                        ipmb_notify_client ( current_msg_rx );
-                    } else {
-                        vPortFree(current_msg_rx);
-                    }
-                    /* If we received a response that doesn't match a previously sent request, just discard it */
-                } else {
-                    vPortFree(current_msg_rx);
-                }
+        /* The NetFN parity is enough to tell requests from responses, no need to decode the whole frame */
+        if ( ( current_msg_rx->frame[1] >> 2 ) & 0x01 ) {
+            /* The message is a response, check if it matches an outstanding request and was received in time.
+             * A matching response releases its sequence number, responses that don't match a previously sent request are just discarded */
+            ipmb_match_response( ipmb_decode_frame( current_msg_rx ) );
+            ipmb_msg_free( current_msg_rx );
 
-            }else {
-                /* The received message is a request */
+        } else {
+            /* The received message is a request, the client will decode it in place */
 
-                /* Notify the client about the new request */
-                ipmb_notify_client ( current_msg_rx );
-            }
+            /* Notify the client about the new request */
+            ipmb_notify_client ( current_msg_rx );
         }
     }
 }
 
 void ipmb_init ( void )
 {
-    vI2CConfig( IPMB_I2C, IPMB_I2C_FREQ );
-
-    /* vI2CSlaveSetup expects i2c addr < 0x80, ipmb_addr is in format XXXX XXX0 */
-    vI2CSlaveSetup( IPMB_I2C, ipmb_addr >> 1);
+    ipmi_msg_cfg *rx_cfg;
 
     ipmb_txqueue = xQueueCreate( IPMB_TXQUEUE_LEN, sizeof(ipmi_msg_cfg *) );
     vQueueAddToRegistry( ipmb_txqueue, "IPMB_TX_QUEUE");
 
+    ipmb_rxqueue = xQueueCreate( IPMB_RXQUEUE_LEN, sizeof(ipmi_msg_cfg *) );
+    vQueueAddToRegistry( ipmb_rxqueue, "IPMB_RX_QUEUE");
+
+    /* The first frame is received in this buffer, the slave callback arms the next ones */
+    rx_cfg = ipmb_msg_alloc();
+    configASSERT( rx_cfg );
+
+    vI2CConfig( IPMB_I2C, IPMB_I2C_FREQ );
+
+    /* vI2CSlaveSetup expects i2c addr < 0x80, ipmb_addr is in format XXXX XXX0 */
+    vI2CSlaveSetup( IPMB_I2C, ipmb_addr >> 1, &rx_cfg->frame[1], IPMI_MSG_MAX_LENGTH - 1, ipmb_slave_rx );
+
     xTaskCreate( IPMB_TXTask, (const char*)"IPMB_TX", 100, ( void * ) NULL, tskIPMB_TX_PRIORITY, ( TaskHandle_t * ) NULL );
     xTaskCreate( IPMB_RXTask, (const char*)"IPMB_RX", 100, ( void * ) NULL, tskIPMB_RX_PRIORITY, ( TaskHandle_t * ) NULL );
 }
 
 ipmb_error ipmb_send_request ( ipmi_msg * req )
 {
-    ipmi_msg_cfg *req_cfg = pvPortMalloc( sizeof( ipmi_msg_cfg ) );
+    ipmi_msg_cfg *req_cfg = ipmb_msg_alloc();
+    ipmb_pending_req *entry;
+    TickType_t elapsed;
+    uint8_t state;
+    uint8_t seq;
+
+    if ( req_cfg == NULL ) {
+        return ipmb_error_failure;
+    }
 
     /* Builds the message according to the IPMB specification */
 
@@ -259,24 +536,64 @@ ipmb_error ipmb_send_request ( ipmi_msg * req )
     req_cfg->buffer.dest_addr = MCH_ADDRESS;
     req_cfg->buffer.dest_LUN = 0;
     req_cfg->buffer.src_addr = ipmb_addr;
-    req_cfg->buffer.seq = current_seq++;
     req_cfg->buffer.src_LUN = 0;
     req_cfg->caller_task = xTaskGetCurrentTaskHandle();
     req_cfg->retries = 0;
+    req_cfg->arb_lost = 0;
+    req_cfg->timestamp = xTaskGetTickCount();
+
+    /* Reserve a sequence number that isn't being used by any outstanding request */
+    if ( !ipmb_alloc_seq( &req_cfg->buffer ) ) {
+        ipmb_msg_free( req_cfg );
+        return ipmb_error_failure;
+    }
+
+    seq = req_cfg->buffer.seq;
 
     /* Blocks here until is able put message in tx queue */
     if (xQueueSend( ipmb_txqueue, &req_cfg, portMAX_DELAY) != pdTRUE ){
-        vPortFree( req_cfg );
+        ipmb_update_seq( seq, false );
+        ipmb_msg_free( req_cfg );
         return ipmb_error_failure;
     }
 
-    /* Use this notification to block the function while the response does not arrive */
-    return ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+    /* Use this notification to block the function while the request is not sent (the TX task frees the buffer) */
+    if ( ulTaskNotifyTake( pdTRUE, portMAX_DELAY ) != ipmb_error_success ) {
+        return ipmb_error_failure;
+    }
+
+    /* Now wait for the response, ipmb_match_response() marks the entry and notifies us */
+    entry = &pending_req[seq];
+    for ( ;; ) {
+        taskENTER_CRITICAL();
+        state = entry->state;
+        elapsed = xTaskGetTickCount() - entry->timestamp;
+        if ( ( state == IPMB_REQ_ANSWERED ) || ( elapsed >= IPMB_MSG_TIMEOUT ) ) {
+            entry->state = IPMB_REQ_FREE;
+        }
+        taskEXIT_CRITICAL();
+
+        if ( state == IPMB_REQ_ANSWERED ) {
+            /* Consume the notification given along with the response, so it doesn't wake up our next wait */
+            ulTaskNotifyTake( pdTRUE, 0 );
+            return ipmb_error_success;
+        }
+
+        if ( elapsed >= IPMB_MSG_TIMEOUT ) {
+            return ipmb_error_timeout;
+        }
+
+        ulTaskNotifyTake( pdTRUE, IPMB_MSG_TIMEOUT - elapsed );
+    }
 }
 
 ipmb_error ipmb_send_response ( ipmi_msg * req, ipmi_msg * resp )
 {
-    ipmi_msg_cfg *resp_cfg = pvPortMalloc( sizeof(ipmi_msg_cfg) );
+    ipmi_msg_cfg *resp_cfg = ipmb_msg_alloc();
+
+    if ( resp_cfg == NULL ) {
+        return ipmb_error_failure;
+    }
 
     /* Builds the message according to the IPMB specification */
 
@@ -293,10 +610,12 @@ ipmb_error ipmb_send_response ( ipmi_msg * req, ipmi_msg * resp )
     resp_cfg->buffer.cmd = req->cmd;
     resp_cfg->caller_task = xTaskGetCurrentTaskHandle();
     resp_cfg->retries = 0;
+    resp_cfg->arb_lost = 0;
+    resp_cfg->timestamp = xTaskGetTickCount();
 
     /* Blocks here until is able put message in tx queue */
     if ( xQueueSend( ipmb_txqueue, &resp_cfg, portMAX_DELAY) != pdTRUE ){
-        vPortFree( resp_cfg );
+        ipmb_msg_free( resp_cfg );
         return ipmb_error_failure;
     }
 
@@ -308,20 +627,18 @@ ipmb_error ipmb_notify_client ( ipmi_msg_cfg * msg_cfg )
 {
     configASSERT( client_queue );
     configASSERT( msg_cfg );
-    /* Sends only the ipmi msg, not the control struct */
-    if (!IS_RESPONSE(msg_cfg->buffer)) {
-        if ( xQueueSend( client_queue, &(msg_cfg->buffer), CLIENT_NOTIFY_TIMEOUT ) == pdFALSE ) {
-            /* This shouldn't happen, but if it does, clear the message buffer, since the IPMB_TX task gives us its ownership */
-            vPortFree( msg_cfg );
-            return ipmb_error_timeout;
-        }
-    }
+
     if ( msg_cfg->caller_task ) {
         xTaskNotifyGive( msg_cfg->caller_task );
     }
 
-    /* The message has already been copied to the responsible task, free it so we don't run out of resources */
-    vPortFree( msg_cfg );
+    /* Only the buffer pointer is queued, from now on the client owns the buffer */
+    if ( xQueueSend( client_queue, &msg_cfg, CLIENT_NOTIFY_TIMEOUT ) == pdFALSE ) {
+        /* This shouldn't happen, but if it does, clear the message buffer, since the IPMB_RX task gives us its ownership */
+        link_stats.client_notify_timeout++;
+        ipmb_msg_free( msg_cfg );
+        return ipmb_error_timeout;
+    }
 
     return ipmb_error_success;
 }
@@ -330,7 +647,7 @@ ipmb_error ipmb_register_rxqueue ( QueueHandle_t * queue )
 {
     configASSERT( queue != NULL );
 
-    *queue = xQueueCreate( IPMB_CLIENT_QUEUE_LEN, sizeof( ipmi_msg ) );
+    *queue = xQueueCreate( IPMB_CLIENT_QUEUE_LEN, sizeof( ipmi_msg_cfg * ) );
     vQueueAddToRegistry(*queue, "ipmi_rx_queue");
     /* Copies the queue handler so we know where to write */
     client_queue = *queue;
@@ -341,6 +658,129 @@ ipmb_error ipmb_register_rxqueue ( QueueHandle_t * queue )
     }
 }
 
+ipmi_msg_cfg * ipmb_msg_alloc ( void )
+{
+    uint32_t free_mask;
+    uint8_t slot = IPMB_MSG_POOL_SIZE;
+    uint8_t in_use;
+    uint8_t bit;
+
+    for ( uint8_t w = 0; ( w < IPMB_MSG_POOL_WORDS ) && ( slot == IPMB_MSG_POOL_SIZE ); w++ ) {
+        free_mask = __atomic_load_n( &ipmb_msg_pool_free[w], __ATOMIC_RELAXED );
+
+        while ( free_mask != 0 ) {
+            bit = __builtin_ctz( free_mask );
+            if ( __atomic_compare_exchange_n( &ipmb_msg_pool_free[w], &free_mask, free_mask & ~( 1UL << bit ),
+                                              false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) {
+                slot = ( 32 * w ) + bit;
+                break;
+            }
+        }
+    }
+
+    if ( slot == IPMB_MSG_POOL_SIZE ) {
+        __atomic_fetch_add( &pool_stats.alloc_failures, 1, __ATOMIC_RELAXED );
+        return NULL;
+    }
+
+    in_use = __atomic_add_fetch( &pool_stats.in_use, 1, __ATOMIC_RELAXED );
+    if ( in_use > pool_stats.peak_in_use ) {
+        /* Racing updates may only lose a transient peak, which is fine for a statistic */
+        pool_stats.peak_in_use = in_use;
+    }
+
+    return &ipmb_msg_pool[slot];
+}
+
+void ipmb_msg_free ( ipmi_msg_cfg * msg_cfg )
+{
+    uint32_t slot;
+
+    if ( msg_cfg == NULL ) {
+        return;
+    }
+
+    slot = msg_cfg - &ipmb_msg_pool[0];
+    configASSERT( slot < IPMB_MSG_POOL_SIZE );
+
+    __atomic_sub_fetch( &pool_stats.in_use, 1, __ATOMIC_RELAXED );
+    __atomic_fetch_or( &ipmb_msg_pool_free[slot / 32], ( 1UL << ( slot % 32 ) ), __ATOMIC_RELEASE );
+}
+
+ipmi_msg * ipmb_decode_frame ( ipmi_msg_cfg * msg_cfg )
+{
+    configASSERT( msg_cfg );
+
+    /* Request frames don't carry a completion code, make sure no stale value is left from a previous use of this buffer */
+    msg_cfg->buffer.completion_code = 0;
+    ipmb_decode( &msg_cfg->buffer, msg_cfg->frame, msg_cfg->frame_len );
+
+    return &msg_cfg->buffer;
+}
+
+void ipmb_get_link_stats ( ipmb_link_stats * stats )
+{
+    configASSERT( stats );
+
+    taskENTER_CRITICAL();
+    *stats = link_stats;
+    taskEXIT_CRITICAL();
+}
+
+void ipmb_reset_link_stats ( void )
+{
+    taskENTER_CRITICAL();
+    memset( &link_stats, 0, sizeof( link_stats ) );
+    taskEXIT_CRITICAL();
+}
+
+void ipmb_get_pool_stats ( ipmb_pool_stats * stats )
+{
+    configASSERT( stats );
+
+    taskENTER_CRITICAL();
+    *stats = pool_stats;
+    taskEXIT_CRITICAL();
+}
+
+bool ipmb_match_response ( ipmi_msg * resp )
+{
+    ipmb_pending_req *entry;
+    TickType_t elapsed;
+    bool match = false;
+
+    configASSERT( resp );
+
+    if ( resp->seq >= IPMB_SEQ_COUNT ) {
+        link_stats.resp_unmatched++;
+        return false;
+    }
+
+    entry = &pending_req[resp->seq];
+
+    taskENTER_CRITICAL();
+    elapsed = xTaskGetTickCount() - entry->timestamp;
+    if ( ( entry->state == IPMB_REQ_SENT ) &&
+         ( ( entry->netfn + 1 ) == resp->netfn ) &&
+         ( entry->cmd == resp->cmd ) &&
+         ( entry->dest_addr == resp->src_addr ) ) {
+        if ( elapsed < IPMB_MSG_TIMEOUT ) {
+            /* Response consumed, the requester releases the sequence number when it wakes up */
+            entry->state = IPMB_REQ_ANSWERED;
+            xTaskNotify( entry->caller_task, ipmb_error_success, eSetValueWithOverwrite );
+            ipmb_hist_add( link_stats.req_resp_hist, elapsed );
+            match = true;
+        } else {
+            link_stats.resp_late++;
+        }
+    } else {
+        link_stats.resp_unmatched++;
+    }
+    taskEXIT_CRITICAL();
+
+    return match;
+}
+
 ipmb_error ipmb_assert_chksum ( uint8_t * buffer, uint8_t buffer_len )
 {
     configASSERT( buffer );
@@ -353,9 +793,9 @@ ipmb_error ipmb_assert_chksum ( uint8_t * buffer, uint8_t buffer_len )
         if ( msg_chksum == calc_msg_chksum ) {
             return ipmb_error_success;
         }
-        return ipmb_error_hdr_chksum;
+        return ipmb_error_msg_chksum;
     }
-    return ipmb_error_msg_chksum;
+    return ipmb_error_hdr_chksum;
 }
 
 ipmb_error ipmb_encode ( uint8_t * buffer, ipmi_msg * msg )
@@ -36,6 +36,8 @@
 #include "semphr.h"
 #include "board_ipmb.h"
 
+#include <stdbool.h>
+
 
 /**
  * @brief Address out of range of the MicroTCA Carrier's AMC Slot ID
@@ -53,9 +55,61 @@
 #define IPMB_CLIENT_QUEUE_LEN   10
 
 /**
- * @brief Maximum retries made by IPMB TX Task when sending a message
+ * @brief Maximum count of received frames waiting to be checked by the IPMB RX task
+ */
+#define IPMB_RXQUEUE_LEN        4
+
+/**
+ * @brief Maximum count of messages backing off in the IPMB TX task before being retried
+ */
+#define IPMB_TX_BACKOFF_LEN     3
+
+/**
+ * @brief Number of message buffers in the IPMB message pool
+ *
+ * Enough buffers to fill the RX, TX and client queues and the TX backoff list, plus one armed in the I2C slave driver, one being checked by
+ * the RX task, one being handled by the client, three held by the client's deferred worker and one being built by a sender.
  */
-#define IPMB_MAX_RETRIES        3
+#define IPMB_MSG_POOL_SIZE      (IPMB_TXQUEUE_LEN + IPMB_CLIENT_QUEUE_LEN + IPMB_RXQUEUE_LEN + IPMB_TX_BACKOFF_LEN + 7)
+
+/**
+ * @brief Number of 32-bit words in the IPMB message pool free bitmap
+ */
+#define IPMB_MSG_POOL_WORDS     ((IPMB_MSG_POOL_SIZE + 31) / 32)
+
+#if IPMB_MSG_POOL_WORDS > 2
+#error "The IPMB message pool free bitmap holds at most 64 buffers"
+#endif
+
+/**
+ * @brief Maximum retries made by IPMB TX Task when sending a response
+ */
+#define IPMB_MAX_RESP_RETRIES   3
+
+/**
+ * @brief Maximum retries made by IPMB TX Task when sending a request
+ *
+ * Requests have a larger budget than responses: nobody is waiting on a short timeout for them and an event lost here is never seen by the
+ * event receiver.
+ */
+#define IPMB_MAX_REQ_RETRIES    5
+
+/**
+ * @brief Maximum arbitration losses tolerated when sending a message
+ *
+ * Losing the arbitration only means another controller is using the bus, so it doesn't consume the retry budget above.
+ */
+#define IPMB_MAX_ARB_LOST       16
+
+/**
+ * @brief Backoff window of the first retry (doubled on each new retry)
+ */
+#define IPMB_TX_BACKOFF_BASE    (2/portTICK_PERIOD_MS)
+
+/**
+ * @brief Maximum backoff window
+ */
+#define IPMB_TX_BACKOFF_MAX     (64/portTICK_PERIOD_MS)
 
 /**
  * @brief Timeout limit between the end of a request and start of a response (defined in IPMB timing specifications)
@@ -112,6 +166,11 @@
 #define IPMB_SEQ_MASK           0xFC
 #define IPMB_SRC_LUN_MASK       0x03
 
+/**
+ * @brief Number of distinct sequence numbers (rqSeq is a 6-bit field)
+ */
+#define IPMB_SEQ_COUNT          64
+
 /**
  * @brief MicroTCA's MCH slave address
  */
@@ -172,9 +231,83 @@ typedef struct ipmi_msg_cfg {
     ipmi_msg buffer;                    /**< IPMI Message */
     TaskHandle_t caller_task;           /**< Task to be notified when the send/receive process is done */
     uint8_t retries;                    /**< Current retry counter */
+    uint8_t arb_lost;                   /**< Arbitration losses while sending this message */
     uint32_t timestamp;                 /**< Tick count at the beginning of the process */
+    uint8_t frame_len;                  /**< Amount of valid bytes in #frame */
+    uint8_t frame[IPMI_MSG_MAX_LENGTH]; /**< Raw IPMB frame, written directly by the I2C slave driver <br>
+                                         * The first byte holds our own address, which isn't transmitted on the bus
+                                         */
 } ipmi_msg_cfg;
 
+/**
+ * @brief Message waiting for its backoff delay to expire before being retried by the IPMB TX task
+ */
+typedef struct ipmb_tx_backoff {
+    ipmi_msg_cfg *msg;                  /**< Message to be retried (NULL if the slot is free) */
+    TickType_t start;                   /**< Tick count of the failed attempt */
+    TickType_t delay;                   /**< Ticks to wait after start before the next attempt */
+} ipmb_tx_backoff;
+
+/**
+ * @brief Outstanding request states
+ */
+typedef enum ipmb_req_state {
+    IPMB_REQ_FREE = 0,                  /**< Sequence number is available */
+    IPMB_REQ_QUEUED,                    /**< Request is waiting in the TX queue */
+    IPMB_REQ_SENT,                      /**< Request was sent and is waiting for a response */
+    IPMB_REQ_ANSWERED                   /**< Response received, waiting for the requester to release the entry */
+} ipmb_req_state;
+
+/**
+ * @brief Outstanding request tracking entry
+ *
+ * One entry exists for each possible sequence number, so an incoming response can be matched to its request without searching.
+ */
+typedef struct ipmb_pending_req {
+    uint8_t state;                      /**< Request state @see ipmb_req_state */
+    uint8_t netfn;                      /**< Request Net Function */
+    uint8_t cmd;                        /**< Request Command */
+    uint8_t dest_addr;                  /**< Responder slave address (rsSA) */
+    TickType_t timestamp;               /**< Tick count when the request was sent */
+    TaskHandle_t caller_task;           /**< Task waiting for the response */
+} ipmb_pending_req;
+
+/**
+ * @brief IPMB message pool usage counters
+ */
+typedef struct ipmb_pool_stats {
+    uint32_t alloc_failures;            /**< Number of times a buffer was requested with the pool exhausted */
+    uint8_t in_use;                     /**< Buffers currently in use */
+    uint8_t peak_in_use;                /**< Highest number of buffers in use at the same time */
+} ipmb_pool_stats;
+
+/**
+ * @brief Number of bins in the IPMB latency histograms
+ *
+ * Bin 0 counts latencies below 1 tick, bin n counts latencies in the [2^(n-1), 2^n) ticks range and the last bin counts everything above.
+ */
+#define IPMB_HIST_BINS          12
+
+/**
+ * @brief IPMB link statistics
+ */
+typedef struct ipmb_link_stats {
+    uint32_t rx_frames;                 /**< Frames received from the I2C slave driver */
+    uint32_t rx_dropped;                /**< Frames dropped in the I2C interrupt (no free buffer or RX queue full) */
+    uint32_t rx_hdr_chksum_err;         /**< Frames discarded due to an invalid header checksum */
+    uint32_t rx_msg_chksum_err;         /**< Frames discarded due to an invalid message checksum */
+    uint32_t client_notify_timeout;     /**< Requests dropped because the client queue stayed full for #CLIENT_NOTIFY_TIMEOUT */
+    uint32_t resp_unmatched;            /**< Responses which don't match any outstanding request */
+    uint32_t resp_late;                 /**< Responses received after #IPMB_MSG_TIMEOUT */
+    uint32_t tx_requests;               /**< Requests successfully sent */
+    uint32_t tx_responses;              /**< Responses successfully sent */
+    uint32_t tx_retries;                /**< Failed transmission attempts which were retried */
+    uint32_t tx_failures;               /**< Messages dropped after exhausting their retry or arbitration budget */
+    uint32_t tx_arb_lost;               /**< Transmission attempts which lost the bus arbitration */
+    uint16_t req_resp_hist[IPMB_HIST_BINS]; /**< Time between sending a request and receiving its response (log2 ticks) */
+    uint16_t tx_wait_hist[IPMB_HIST_BINS];  /**< Time messages waited in the TX queue before their first transmission attempt (log2 ticks) */
+} ipmb_link_stats;
+
 /**
  * @brief IPMB errors enumeration
  */
@@ -206,12 +339,14 @@ extern uint8_t ipmb_addr;
  * When #ipmb_send_request or #ipmb_send_response put a message in #ipmb_txqueue, this task unblocks.
  * First step to send a message is differentiating requests from responses. It does this analyzing the parity of NetFN (even for requests, odd for responses).
  *
- * When sending a response, this task has to check if it matches with the sequence number from the last known request and the amount of time it took to be built (timeout checking). Last step is checking if it has already tried to send this message more than #IPMB_MAX_RETRIES value. <br>
- * After passing all checking, the message is formatted as the IPMB protocol demands and passed down to the I2C driver, using the function xI2CWrite(). <br>
- * If an error comes out of the I2C driver when sending the message, it increases the retry counter in the #ipmi_msg_cfg struct and send the message to the front of #ipmb_txqueue. <br>
- * If no errors occurs, the task that put the message in the queue is notified with a success flag.
+ * The message is formatted as the IPMB protocol demands and passed down to the I2C driver. <br>
+ * If the transfer fails, the message is parked in a backoff list and retried after a random delay, drawn from a window which doubles on each
+ * retry (#IPMB_TX_BACKOFF_BASE up to #IPMB_TX_BACKOFF_MAX), so controllers colliding on a shared IPMB don't retry in lockstep. Meanwhile the
+ * other messages keep going out; ready responses are always sent before requests. Responses and requests have separate retry budgets
+ * (#IPMB_MAX_RESP_RETRIES and #IPMB_MAX_REQ_RETRIES), and arbitration losses are counted apart (#IPMB_MAX_ARB_LOST). <br>
+ * When the message is sent, or its budget is exhausted, the task that put the message in the queue is notified with the result.
  *
- * The proccess is analog when sending a request, but the only check that is made is the retry number. The task skip all checking because, when sending a request, the message is formatted using it's own functions #ipmb_send_request or #ipmb_send_response and they are guaranteed to put only valid messages in queue.
+ * The task skip all checking because the messages are formatted using it's own functions #ipmb_send_request or #ipmb_send_response and they are guaranteed to put only valid messages in queue.
  * @param pvParameters: Default parameter to FreeRTOS tasks, not used here.
  * @see IPMB_RXTask
  * @see ipmb_send_request
@@ -222,11 +357,15 @@ void IPMB_TXTask ( void *pvParameters );
 /**
  * @brief IPMB Receiver Task
  *
- * Similarly to #IPMB_TXTask, this task remains blocked until a new message is received by the I2C driver. The message passes through checksum checking to assure its integrity. <br>
+ * Similarly to #IPMB_TXTask, this task remains blocked until a new frame is received by the I2C driver. The I2C slave interrupt writes the frame
+ * directly into a pool buffer and queues only its pointer, so the frame is never copied before being decoded. The message passes through checksum checking to assure its integrity. <br>
  * If the message is a request, we have to check if it's a new one or just a retransmission of the last. In order to do this, the sequential number is tested, since every request has a different one.<br>
  * Right after that, the arrival time and the message body are stored for future checking and the specified client is notified using #ipmb_notify_client.
  *
- * If we have received a response instead, we match it with the last stored request and also check if the awating request hasn't timed-out yet.
+ * Requests are handed to the client still encoded, the client decodes them in place with #ipmb_decode_frame.
+ *
+ * If we have received a response instead, we look up the outstanding request with the same sequence number and check that its NetFN, command and
+ * responder address match and that it hasn't timed-out yet (see #ipmb_match_response).
  *
  * @note When a malformed message, a response without a request or a repeated request are received, they are just ignored, following the IPMB specifications.
  *
@@ -245,6 +384,12 @@ void ipmb_init ( void );
 
 /**
  * @brief Format and send a request via IPMB channel
+ *
+ * Blocks until the response arrives or #IPMB_MSG_TIMEOUT ticks after the request was sent.
+ *
+ * @retval ipmb_error_success The responder answered the request
+ * @retval ipmb_error_timeout The request was sent, but no response arrived in time
+ * @retval ipmb_error_failure The request couldn't be sent
  */
 ipmb_error ipmb_send_request ( ipmi_msg * req );
 
@@ -259,6 +404,9 @@ ipmb_error ipmb_send_response ( ipmi_msg * req, ipmi_msg * resp );
  * The queue is created and its handler is written at the given pointer (queue).
  * Also keeps a copy of the handler to know where to write the incoming messages.
  *
+ * The queue carries pointers to #ipmi_msg_cfg pool buffers holding the raw frames. The client owns each buffer it receives: it should decode
+ * it with #ipmb_decode_frame and give it back with #ipmb_msg_free once the request is handled.
+ *
  * @param queue Pointer to a QueueHandle_t variable which will be written by this function.
  *
  * @retval ipmb_error_success The queue was successfully created.
@@ -266,6 +414,65 @@ ipmb_error ipmb_send_response ( ipmi_msg * req, ipmi_msg * resp );
  */
 ipmb_error ipmb_register_rxqueue ( QueueHandle_t * queue );
 
+/**
+ * @brief Takes a message buffer from the IPMB message pool
+ *
+ * The pool is a static array of #IPMB_MSG_POOL_SIZE buffers tracked by a free bitmap, made of 32-bit words (the largest
+ * atomic operations of the Cortex-M3) each updated with compare-and-swap operations. Acquiring and releasing a buffer is O(1), never blocks and is safe to call from interrupts.
+ *
+ * @return Pointer to a free buffer, or NULL if the pool is exhausted (the failure is counted in #ipmb_pool_stats)
+ */
+ipmi_msg_cfg * ipmb_msg_alloc ( void );
+
+/**
+ * @brief Returns a message buffer to the IPMB message pool
+ *
+ * @param msg_cfg Buffer previously returned by #ipmb_msg_alloc (NULL is ignored)
+ */
+void ipmb_msg_free ( ipmi_msg_cfg * msg_cfg );
+
+/**
+ * @brief Decodes the raw frame stored in a message buffer into its #ipmi_msg field
+ *
+ * @param msg_cfg Buffer received from the client queue
+ *
+ * @return Pointer to the decoded message, which lives inside \p msg_cfg
+ */
+ipmi_msg * ipmb_decode_frame ( ipmi_msg_cfg * msg_cfg );
+
+/**
+ * @brief Reads the IPMB message pool usage counters
+ *
+ * @param[out] stats Pointer to the struct which will hold the counters
+ */
+void ipmb_get_pool_stats ( ipmb_pool_stats * stats );
+
+/**
+ * @brief Reads the IPMB link statistics
+ *
+ * @param[out] stats Pointer to the struct which will hold the statistics
+ */
+void ipmb_get_link_stats ( ipmb_link_stats * stats );
+
+/**
+ * @brief Clears the IPMB link statistics
+ */
+void ipmb_reset_link_stats ( void );
+
+/**
+ * @brief Matches an incoming response with an outstanding request
+ *
+ * The sequence number indexes the pending request table directly. The response is accepted only if the entry was sent less than
+ * #IPMB_MSG_TIMEOUT ticks ago and its NetFN, command and responder address match the response. A matched entry is marked as answered
+ * and the requester, blocked in #ipmb_send_request, is notified and releases it.
+ *
+ * @param resp Decoded response message
+ *
+ * @retval true The response matches an outstanding request
+ * @retval false No request is waiting for this response (late, duplicated or unknown)
+ */
+bool ipmb_match_response ( ipmi_msg * resp );
+
 /**
  * @brief Asserts the input message checksums by comparing them with our calculated ones.
  *
@@ -55,68 +55,515 @@ volatile const t_req_handler_record *ipmiEntries = (t_req_handler_record *) &_ip
  */
 volatile const t_req_handler_record *ipmiEntries_end = (t_req_handler_record *) &_eipmi_handlers;
 
+/**
+ * @brief Per-NetFN command dispatch index, built by #ipmi_dispatch_init
+ */
+static ipmi_netfn_dispatch ipmi_dispatch[IPMI_NETFN_COUNT];
+
+/**
+ * @brief Platform events waiting to be delivered
+ */
+static ipmi_event_entry ipmi_event_outbox[IPMI_EVENT_OUTBOX_LEN];
+
+/**
+ * @brief Arrival counter, keeps the events FIFO ordered inside each priority
+ */
+static uint32_t ipmi_event_order;
+
+/**
+ * @brief Wakes up the event task when a new event is queued
+ */
+static SemaphoreHandle_t ipmi_event_sem;
+
+/**
+ * @brief Number of events dropped (outbox full or too many retries)
+ */
+uint32_t ipmi_event_dropped;
+
+/**
+ * @brief Number of events cancelled by an opposite event before being delivered
+ */
+uint32_t ipmi_event_coalesced;
+
+/**
+ * @brief Queue that holds the requests waiting for the deferred worker
+ */
+QueueHandle_t ipmi_deferred_queue = NULL;
+
+/**
+ * @brief Requests owned by the deferred worker (queued or being handled)
+ */
+static ipmi_msg_cfg *ipmi_deferred_reqs[IPMI_DEFERRED_QUEUE_LEN + 1];
+
+/**
+ * @brief Checks if a request is a retransmission of one still owned by the deferred worker
+ */
+static bool ipmi_deferred_pending( ipmi_msg * req )
+{
+    ipmi_msg *pending;
+    bool found = false;
+
+    taskENTER_CRITICAL();
+    for ( uint8_t i = 0; i < IPMI_DEFERRED_QUEUE_LEN + 1; i++ ) {
+        if ( ipmi_deferred_reqs[i] == NULL ) {
+            continue;
+        }
+        pending = &ipmi_deferred_reqs[i]->buffer;
+        if ( ( pending->src_addr == req->src_addr ) && ( pending->seq == req->seq ) &&
+             ( pending->netfn == req->netfn ) && ( pending->cmd == req->cmd ) ) {
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return found;
+}
+
+/**
+ * @brief Hands a request over to the deferred worker
+ *
+ * @retval true The worker owns the request buffer now
+ * @retval false The worker backlog is full
+ */
+static bool ipmi_deferred_post( ipmi_msg_cfg * req_cfg )
+{
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    for ( i = 0; i < IPMI_DEFERRED_QUEUE_LEN + 1; i++ ) {
+        if ( ipmi_deferred_reqs[i] == NULL ) {
+            ipmi_deferred_reqs[i] = req_cfg;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if ( i == IPMI_DEFERRED_QUEUE_LEN + 1 ) {
+        return false;
+    }
+
+    if ( xQueueSend( ipmi_deferred_queue, &req_cfg, 0 ) != pdTRUE ) {
+        ipmi_deferred_reqs[i] = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Responses recently sent, replayed to retransmitted requests
+ */
+static ipmi_replay_entry ipmi_replay_cache[IPMI_REPLAY_CACHE_LEN];
+
+/**
+ * @brief Next replay cache entry to be overwritten
+ */
+static uint8_t ipmi_replay_next;
+
+/**
+ * @brief Number of retransmitted requests answered from the replay cache
+ */
+uint32_t ipmi_replay_hits;
+
+/**
+ * @brief Checksum of a request data, so a new request reusing the 6-bit sequence number isn't taken for a retransmission
+ */
+static uint16_t ipmi_replay_sum( ipmi_msg * req )
+{
+    uint8_t sum1 = 0, sum2 = 0;
+
+    /* Fletcher-16 (mod 255 sums), unlike a plain sum it depends on the bytes order */
+    for ( uint8_t i = 0; i < req->data_len; i++ ) {
+        sum1 = ( sum1 + req->data[i] ) % 255;
+        sum2 = ( sum2 + sum1 ) % 255;
+    }
+
+    return ( sum2 << 8 ) | sum1;
+}
+
+/**
+ * @brief Looks up the response to a retransmitted request
+ *
+ * @param[in] req Incoming request
+ * @param[out] resp Copy of the cached response
+ *
+ * @retval true The request was answered less than #IPMI_REPLAY_CACHE_TIMEOUT ago, \p resp holds the response
+ * @retval false No response was found
+ */
+static bool ipmi_replay_lookup( ipmi_msg * req, ipmi_msg * resp )
+{
+    ipmi_replay_entry *entry;
+    TickType_t now = xTaskGetTickCount();
+    uint16_t sum = ipmi_replay_sum( req );
+    bool found = false;
+
+    taskENTER_CRITICAL();
+    for ( uint8_t i = 0; i < IPMI_REPLAY_CACHE_LEN; i++ ) {
+        entry = &ipmi_replay_cache[i];
+
+        if ( entry->valid && ( entry->rq_addr == req->src_addr ) && ( entry->seq == req->seq ) &&
+             ( entry->netfn == req->netfn ) && ( entry->cmd == req->cmd ) && ( entry->req_len == req->data_len ) &&
+             ( entry->req_sum == sum ) ) {
+            if ( ( now - entry->timestamp ) < IPMI_REPLAY_CACHE_TIMEOUT ) {
+                resp->completion_code = entry->completion_code;
+                resp->data_len = entry->data_len;
+                memcpy( resp->data, entry->data, entry->data_len );
+                found = true;
+            } else {
+                /* Expired, the requester is reusing the sequence number */
+                entry->valid = 0;
+            }
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return found;
+}
+
+/**
+ * @brief Stores a response in the replay cache, overwriting the oldest entry
+ */
+static void ipmi_replay_store( ipmi_msg * req, ipmi_msg * resp )
+{
+    ipmi_replay_entry *entry;
+    uint16_t sum = ipmi_replay_sum( req );
+
+    /* The command isn't over yet, a retransmission has to check its progress again */
+    if ( ( resp->completion_code == IPMI_CC_COMMAND_IN_PROGRESS ) || ( resp->data_len > sizeof( entry->data ) ) ) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    entry = &ipmi_replay_cache[ipmi_replay_next];
+    ipmi_replay_next = ( ipmi_replay_next + 1 ) % IPMI_REPLAY_CACHE_LEN;
+
+    entry->valid = 1;
+    entry->rq_addr = req->src_addr;
+    entry->seq = req->seq;
+    entry->netfn = req->netfn;
+    entry->cmd = req->cmd;
+    entry->req_len = req->data_len;
+    entry->req_sum = sum;
+    entry->timestamp = xTaskGetTickCount();
+    entry->completion_code = resp->completion_code;
+    entry->data_len = resp->data_len;
+    memcpy( entry->data, resp->data, resp->data_len );
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Calls a handler and sends its response
+ */
+static void ipmi_run_handler( const t_req_handler_record * record, ipmi_msg * req )
+{
+    ipmi_msg response;
+
+    response.completion_code = IPMI_CC_UNSPECIFIED_ERROR;
+    response.data_len = 0;
+
+    /// Call user-defined function, give request data and retrieve required response
+    record->req_handler(req, &response);
+
+    /* Keep the response so a retransmission of this request doesn't repeat the handler side effects. The handlers
+     * without side effects are simply run again, so the polled commands don't evict the entries that matter. */
+    if (record->flags & IPMI_HANDLER_FLAG_REPLAY) {
+        ipmi_replay_store(req, &response);
+    }
+
+    /** In case of error during IPMB response, the MMC waits for the MCH to
+       retry the request. The responses dropped after all their retries are
+       counted in the IPMB link statistics (tx_failures). */
+    ipmb_send_response(req, &response);
+}
+
+/**
+ * @brief Sends a response carrying only a completion code
+ */
+static void ipmi_send_cc( ipmi_msg * req, uint8_t completion_code )
+{
+    ipmi_msg response;
+
+    response.completion_code = completion_code;
+    response.data_len = 0;
+    ipmb_send_response(req, &response);
+}
+
 void IPMITask( void * pvParameters )
 {
-    ipmi_msg req_received;
+    ipmi_msg_cfg *req_cfg;
+    ipmi_msg *req_received;
     ipmi_msg response;
-    ipmb_error error_code;
-    t_req_handler req_handler = (t_req_handler) 0;
+    const t_req_handler_record *record;
 
     for ( ;; ) {
 
-        if( xQueueReceive( ipmi_rxqueue, &req_received , portMAX_DELAY ) == pdFALSE) {
+        if( xQueueReceive( ipmi_rxqueue, &req_cfg , portMAX_DELAY ) == pdFALSE) {
             /* Should no return pdFALSE */
             configASSERT(pdFALSE);
             continue;
         }
+
+        /* The request is decoded inside its own IPMB buffer, no copies are made */
+        req_received = ipmb_decode_frame( req_cfg );
 #if 0
         printf(" IPMI Message Received: \n ");
-        printf(" \tNETFn: 0x%X\tCMD: 0x%X\t Data: ", req_received.netfn, req_received.cmd);
-        for (int i=0; i < req_received.data_len; i++) {
-            printf("0x%X ", req_received.data[i]);
+        printf(" \tNETFn: 0x%X\tCMD: 0x%X\t Data: ", req_received->netfn, req_received->cmd);
+        for (int i=0; i < req_received->data_len; i++) {
+            printf("0x%X ", req_received->data[i]);
         }
         printf("\n");
 #endif
-        req_handler = (t_req_handler) 0;
-        req_handler = ipmi_retrieve_handler(req_received.netfn, req_received.cmd);
+        if (ipmi_replay_lookup(req_received, &response)) {
+            /* Our response was lost or late, send it again without repeating the handler side effects */
+            ipmi_replay_hits++;
+            ipmb_send_response(req_received, &response);
+            ipmb_msg_free( req_cfg );
+            continue;
+        }
 
-        if (req_handler != 0) {
+        record = ipmi_retrieve_record(req_received->netfn, req_received->cmd);
 
-            response.completion_code = IPMI_CC_UNSPECIFIED_ERROR;
-            response.data_len = 0;
+        if (record == NULL) {
+            /** If there is no function handler, use data from received
+             *  message to send "invalid command" response (IPMI table 5-2,
+             *  page 44). */
+            ipmi_send_cc(req_received, IPMI_CC_INV_CMD);
+
+        } else if (record->flags & IPMI_HANDLER_FLAG_DEFERRED) {
+            /* Slow command, let the worker handle it so the next requests aren't delayed */
+            if (ipmi_deferred_pending(req_received)) {
+                /* The requester timed out and retried, but we're still working on the original request */
+                ipmi_send_cc(req_received, IPMI_CC_COMMAND_IN_PROGRESS);
+            } else if (ipmi_deferred_post(req_cfg)) {
+                /* The worker will respond and release the buffer */
+                continue;
+            } else {
+                ipmi_send_cc(req_received, IPMI_CC_NODE_BUSY);
+            }
 
-            /// Call user-defined function, give request data and retrieve required response
+        } else {
             /** @warning Since IPMI task have a high priority, this handler function should not wait other tasks to unblock */
-            req_handler(&req_received, &response);
+            ipmi_run_handler(record, req_received);
+        }
 
-            error_code = ipmb_send_response(&req_received, &response);
+        ipmb_msg_free( req_cfg );
+    }
+}
 
-            /** In case of error during IPMB response, the MMC may wait for a
-               new command from the MCH. Check this for debugging purposes
-               only. */
-            configASSERT( (error_code == ipmb_error_success) );
+void IPMIDeferredTask( void * pvParameters )
+{
+    ipmi_msg_cfg *req_cfg;
+    const t_req_handler_record *record;
 
-        } else {
-            /** If there is no function handler, use data from received
-             *  message to send "invalid command" response (IPMI table 5-2,
-             *  page 44). */
+    for ( ;; ) {
+        xQueueReceive( ipmi_deferred_queue, &req_cfg, portMAX_DELAY );
 
-            response.completion_code = IPMI_CC_INV_CMD;
-            response.data_len = 0;
-            error_code = ipmb_send_response(&req_received, &response);
+        record = ipmi_retrieve_record(req_cfg->buffer.netfn, req_cfg->buffer.cmd);
+        ipmi_run_handler(record, &req_cfg->buffer);
 
-            configASSERT((error_code == ipmb_error_success));
+        taskENTER_CRITICAL();
+        for ( uint8_t i = 0; i < IPMI_DEFERRED_QUEUE_LEN + 1; i++ ) {
+            if ( ipmi_deferred_reqs[i] == req_cfg ) {
+                ipmi_deferred_reqs[i] = NULL;
+            }
         }
+        taskEXIT_CRITICAL();
+
+        ipmb_msg_free( req_cfg );
+    }
+}
+
+/**
+ * @brief Checks if an older hot swap event of the same sensor is still waiting to be delivered
+ *
+ * Hot swap events are never coalesced, so they must reach the event receiver in the order the M-state transitions happened
+ *
+ * @note Must be called from a critical section
+ */
+static bool ipmi_event_blocked( ipmi_event_entry *entry )
+{
+    ipmi_event_entry *other;
+
+    if (entry->priority != IPMI_EVENT_PRIO_HOTSWAP) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < IPMI_EVENT_OUTBOX_LEN; i++) {
+        other = &ipmi_event_outbox[i];
+
+        if (other->used && (other->priority == IPMI_EVENT_PRIO_HOTSWAP) && (other->data[2] == entry->data[2]) &&
+            ((int32_t)(other->order - entry->order) < 0)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void IPMIEventTask( void * pvParameters )
+{
+    ipmi_event_entry *entry;
+    ipmi_event_entry *next;
+    ipmi_msg evt;
+    TickType_t now;
+    TickType_t elapsed;
+    TickType_t wait;
+    ipmb_error error;
+
+    evt.dest_LUN = 0;
+    evt.netfn = NETFN_SE;
+    evt.cmd = IPMI_PLATFORM_EVENT_CMD;
+    evt.data_len = IPMI_EVENT_DATA_LEN;
+
+    for ( ;; ) {
+        next = NULL;
+        wait = portMAX_DELAY;
+        now = xTaskGetTickCount();
+
+        /* Pick the ready event with the highest priority, the oldest one if there's a tie. Hot swap events of a sensor are
+         * only sent after its older ones were delivered */
+        taskENTER_CRITICAL();
+        for (uint8_t i = 0; i < IPMI_EVENT_OUTBOX_LEN; i++) {
+            entry = &ipmi_event_outbox[i];
+
+            if (!entry->used) {
+                continue;
+            }
+
+            elapsed = now - entry->last_try;
+            if (elapsed < entry->delay) {
+                /* Still backing off, wake up in time for its next attempt */
+                if ((entry->delay - elapsed) < wait) {
+                    wait = entry->delay - elapsed;
+                }
+                continue;
+            }
+
+            if (ipmi_event_blocked(entry)) {
+                /* An older transition of this sensor is backing off, it will wake us up when it's ready */
+                continue;
+            }
+
+            if ((next == NULL) || (entry->priority < next->priority) ||
+                ((entry->priority == next->priority) && ((int32_t)(entry->order - next->order) < 0))) {
+                next = entry;
+            }
+        }
+
+        if (next) {
+            next->in_flight = 1;
+            memcpy(evt.data, next->data, IPMI_EVENT_DATA_LEN);
+        }
+        taskEXIT_CRITICAL();
+
+        if (next == NULL) {
+            xSemaphoreTake(ipmi_event_sem, wait);
+            continue;
+        }
+
+        error = ipmb_send_request(&evt);
+
+        taskENTER_CRITICAL();
+        next->in_flight = 0;
+        if (error == ipmb_error_success) {
+            next->used = 0;
+        } else if ((next->priority == IPMI_EVENT_PRIO_SENSOR) && (next->retries >= IPMI_EVENT_MAX_RETRIES - 1)) {
+            next->used = 0;
+            ipmi_event_dropped++;
+        } else {
+            /* The event receiver didn't answer, back off and let the other events go first */
+            next->delay = (next->retries < 8) ? (IPMI_EVENT_RETRY_BASE << next->retries) : IPMI_EVENT_RETRY_MAX;
+            if (next->delay > IPMI_EVENT_RETRY_MAX) {
+                next->delay = IPMI_EVENT_RETRY_MAX;
+            }
+            if (next->retries < UINT8_MAX) {
+                next->retries++;
+            }
+            next->last_try = xTaskGetTickCount();
+        }
+        taskEXIT_CRITICAL();
     }
 }
 
 TaskHandle_t TaskIPMI_Handle;
 
+void ipmi_dispatch_init ( void )
+{
+    const t_req_handler_record *records = (const t_req_handler_record *) ipmiEntries;
+    uint16_t record_cnt = (const t_req_handler_record *) ipmiEntries_end - records;
+    ipmi_netfn_dispatch *entry;
+    uint16_t index_size = 0;
+    uint8_t last_cmd[IPMI_NETFN_COUNT] = {0};
+    uint8_t *index;
+    uint8_t *slot;
+    uint16_t i;
+
+    /* Record indexes are stored as (i+1) in a byte, 0 means there's no handler */
+    configASSERT( record_cnt < 0xFF );
+
+    /* First pass: find the command range registered for each NetFN */
+    for ( i = 0; i < record_cnt; i++ ) {
+        entry = &ipmi_dispatch[IPMI_NETFN_SLOT(records[i].netfn)];
+
+        if ( entry->cmd_count == 0 ) {
+            entry->first_cmd = records[i].cmd;
+            last_cmd[IPMI_NETFN_SLOT(records[i].netfn)] = records[i].cmd;
+            entry->cmd_count = 1;
+        } else if ( records[i].cmd < entry->first_cmd ) {
+            entry->first_cmd = records[i].cmd;
+        } else if ( records[i].cmd > last_cmd[IPMI_NETFN_SLOT(records[i].netfn)] ) {
+            last_cmd[IPMI_NETFN_SLOT(records[i].netfn)] = records[i].cmd;
+        }
+    }
+
+    for ( i = 0; i < IPMI_NETFN_COUNT; i++ ) {
+        if ( ipmi_dispatch[i].cmd_count ) {
+            ipmi_dispatch[i].cmd_count = last_cmd[i] - ipmi_dispatch[i].first_cmd + 1;
+            index_size += ipmi_dispatch[i].cmd_count;
+        }
+    }
+
+    /* Second pass: a single allocation holds the command tables of every NetFN */
+    index = pvPortMalloc( index_size );
+    configASSERT( index );
+    memset( index, 0, index_size );
+
+    for ( i = 0; i < IPMI_NETFN_COUNT; i++ ) {
+        ipmi_dispatch[i].index = index;
+        index += ipmi_dispatch[i].cmd_count;
+    }
+
+    /* Third pass: fill the tables. A command registered twice is a firmware bug, so halt right away; if asserts are
+     * compiled out, the first record is kept so the dispatch result doesn't depend on the link order */
+    for ( i = 0; i < record_cnt; i++ ) {
+        entry = &ipmi_dispatch[IPMI_NETFN_SLOT(records[i].netfn)];
+        slot = &entry->index[records[i].cmd - entry->first_cmd];
+
+        configASSERT( *slot == 0 );
+        if ( *slot != 0 ) {
+            continue;
+        }
+        *slot = i + 1;
+    }
+}
+
 void ipmi_init ( void )
 {
+    ipmi_dispatch_init();
     ipmb_init();
     ipmb_register_rxqueue( &ipmi_rxqueue );
+
+    ipmi_deferred_queue = xQueueCreate( IPMI_DEFERRED_QUEUE_LEN, sizeof(ipmi_msg_cfg *) );
+    vQueueAddToRegistry( ipmi_deferred_queue, "ipmi_deferred_queue");
+
     xTaskCreate( IPMITask, (const char*)"IPMI Dispatcher", 256, ( void * ) NULL, tskIPMI_PRIORITY, &TaskIPMI_Handle );
+    xTaskCreate( IPMIDeferredTask, (const char*)"IPMI Deferred", 256, ( void * ) NULL, tskIPMI_DEFERRED_PRIORITY, ( TaskHandle_t * ) NULL );
+
+    ipmi_event_sem = xSemaphoreCreateBinary();
+    configASSERT( ipmi_event_sem );
+    xTaskCreate( IPMIEventTask, (const char*)"IPMI Events", 150, ( void * ) NULL, tskIPMI_EVENT_PRIORITY, ( TaskHandle_t * ) NULL );
 }
 
 /**
@@ -129,53 +576,122 @@ void ipmi_init ( void )
  */
 t_req_handler ipmi_retrieve_handler( uint8_t netfn, uint8_t cmd )
 {
-    t_req_handler handler = 0;
-    t_req_handler_record * p_ptr = (t_req_handler_record *) ipmiEntries;
+    const t_req_handler_record *record = ipmi_retrieve_record( netfn, cmd );
 
-    while (p_ptr < ipmiEntries_end) {
-        if( (p_ptr->netfn == netfn) &&   \
-            (p_ptr->cmd == cmd)) {
-            handler = p_ptr->req_handler;
-            break;
-        }
-        p_ptr++;
+    return ( record ) ? record->req_handler : 0;
+}
+
+const t_req_handler_record * ipmi_retrieve_record( uint8_t netfn, uint8_t cmd )
+{
+    const t_req_handler_record *records = (const t_req_handler_record *) ipmiEntries;
+    ipmi_netfn_dispatch *entry;
+    uint8_t offset;
+    uint8_t record;
+
+    /* Only (even) request NetFNs have handlers */
+    if ( ( netfn & 0x01 ) || ( IPMI_NETFN_SLOT(netfn) >= IPMI_NETFN_COUNT ) ) {
+        return NULL;
+    }
+
+    entry = &ipmi_dispatch[IPMI_NETFN_SLOT(netfn)];
+    offset = cmd - entry->first_cmd;
+
+    /* Commands below first_cmd wrap around and are caught by this check too */
+    if ( offset >= entry->cmd_count ) {
+        return NULL;
     }
 
-    return handler;
+    record = entry->index[offset];
+    if ( record == 0 ) {
+        return NULL;
+    }
+
+    return &records[record - 1];
 }
 
 /**
- * @brief Sends an event message via IPMB interface
+ * @brief Queues an event message to be sent via IPMB interface
  *
  * @param[in] sensor Pointer to sensor structure defined in sensor.h
  * @param[in] assert_deassert Flag to indicate an (de)assertion event
  * @param[in] evData Data buffer holding the event data, size indicated by \p length
  * @param[in] length Lenght of \p evData buffer
  *
- * @return ipmb_error return value from #ipmb_send_request
+ * @return ipmb_error_success if the event was queued, ipmb_error_failure if the outbox is full
  *
- * @see ipmb_send_request()
+ * @see IPMIEventTask()
  */
 ipmb_error ipmi_event_send( sensor_t * sensor, uint8_t assert_deassert, uint8_t *evData, uint8_t length)
 {
-    ipmi_msg evt;
+    ipmi_event_entry *entry;
+    ipmi_event_entry *free_entry = NULL;
+    uint8_t data[IPMI_EVENT_DATA_LEN];
     uint8_t data_len = 0;
+    uint8_t priority;
+    bool coalesced = false;
+    ipmb_error ret = ipmb_error_success;
+
+    data[data_len++] = IPMI_EVENT_MESSAGE_REV;
+    data[data_len++] = GET_SENSOR_TYPE(sensor);
+    data[data_len++] = sensor->num;
+    data[data_len++] = assert_deassert | (GET_EVENT_TYPE_CODE(sensor) & 0x7F);
+    data[data_len++] = (length >= 1)? evData[0] : 0xFF;
+    data[data_len++] = (length >= 2)? evData[1] : 0xFF;
+    data[data_len++] = (length >= 3)? evData[2] : 0xFF;
+
+    priority = (GET_SENSOR_TYPE(sensor) == SENSOR_TYPE_HOT_SWAP) ? IPMI_EVENT_PRIO_HOTSWAP : IPMI_EVENT_PRIO_SENSOR;
+
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < IPMI_EVENT_OUTBOX_LEN; i++) {
+        entry = &ipmi_event_outbox[i];
+
+        if (!entry->used) {
+            if (free_entry == NULL) {
+                free_entry = entry;
+            }
+            continue;
+        }
 
-    evt.dest_LUN = 0;
-    evt.netfn = NETFN_SE;
-    evt.cmd = IPMI_PLATFORM_EVENT_CMD;
+        /* Hot swap events carry the new state, every one of them must be delivered */
+        if ((priority != IPMI_EVENT_PRIO_SENSOR) || (entry->priority != IPMI_EVENT_PRIO_SENSOR) || entry->in_flight) {
+            continue;
+        }
 
-    evt.data[data_len++] = IPMI_EVENT_MESSAGE_REV;
-    evt.data[data_len++] = GET_SENSOR_TYPE(sensor);
-    evt.data[data_len++] = sensor->num;
-    evt.data[data_len++] = assert_deassert | (GET_EVENT_TYPE_CODE(sensor) & 0x7F);
-    evt.data[data_len++] = (length >= 1)? evData[0] : 0xFF;
-    evt.data[data_len++] = (length >= 2)? evData[1] : 0xFF;
-    evt.data[data_len++] = (length >= 3)? evData[2] : 0xFF;
+        /* Same sensor and same event offset */
+        if ((entry->data[2] == data[2]) && ((entry->data[4] & 0x0F) == (data[4] & 0x0F))) {
+            if ((entry->data[3] & DEASSERTION_EVENT) != (data[3] & DEASSERTION_EVENT)) {
+                /* The event receiver never saw the pending event, both cancel out */
+                entry->used = 0;
+                ipmi_event_coalesced++;
+            }
+            /* Otherwise it's the same event, which is already waiting to be delivered */
+            coalesced = true;
+            break;
+        }
+    }
 
-    evt.data_len = data_len;
+    if (!coalesced) {
+        if (free_entry) {
+            free_entry->used = 1;
+            free_entry->in_flight = 0;
+            free_entry->priority = priority;
+            free_entry->retries = 0;
+            free_entry->order = ipmi_event_order++;
+            free_entry->delay = 0;
+            free_entry->last_try = xTaskGetTickCount();
+            memcpy(free_entry->data, data, sizeof(data));
+        } else {
+            ipmi_event_dropped++;
+            ret = ipmb_error_failure;
+        }
+    }
+    taskEXIT_CRITICAL();
 
-    return (ipmb_send_request( &evt ));
+    if (!coalesced && (ret == ipmb_error_success)) {
+        xSemaphoreGive(ipmi_event_sem);
+    }
+
+    return ret;
 }
 
 /**
@@ -279,7 +795,7 @@ IPMI_HANDLER(ipmi_get_device_locator_record, NETFN_GRPEXT, IPMI_PICMG_CMD_GET_DE
     rsp->completion_code = IPMI_CC_OK;
 }
 
-IPMI_HANDLER(ipmi_picmg_cmd_fru_control, NETFN_GRPEXT, IPMI_PICMG_CMD_FRU_CONTROL, ipmi_msg *req, ipmi_msg *rsp)
+IPMI_REPLAYED_HANDLER(ipmi_picmg_cmd_fru_control, NETFN_GRPEXT, IPMI_PICMG_CMD_FRU_CONTROL, ipmi_msg *req, ipmi_msg *rsp)
 {
     uint8_t len = rsp->data_len = 0;
     uint8_t fru_id = req->data[1];
@@ -339,3 +855,91 @@ IPMI_HANDLER(ipmi_custom_cmd_get_free_heap, NETFN_CUSTOM, IPMI_CUSTOM_CMD_MMC_GE
     rsp->data_len = len;
     rsp->completion_code = IPMI_CC_OK;
 }
+
+/*
+ * IPMB link statistics, read one page at a time (selected by the first request byte):
+ *  - 0x00: RX counters
+ *  - 0x01: TX and response matching counters
+ *  - 0x02: Request to response time histogram
+ *  - 0x03: TX queue wait time histogram
+ *  - 0x04: TX arbitration counters
+ *  - 0x10 + n: Master transfer error counters of the I2C interface n
+ *  - 0xFF: Clear all statistics
+ * Counters are 32 bits and histogram bins 16 bits wide, both little-endian.
+ */
+IPMI_HANDLER(ipmi_custom_cmd_get_ipmb_stats, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_IPMB_STATS, ipmi_msg *req, ipmi_msg *rsp)
+{
+    uint8_t len = rsp->data_len = 0;
+    ipmb_link_stats stats;
+    uint32_t counters[6];
+    uint8_t counters_cnt = 0;
+    uint16_t *hist = NULL;
+
+    if (req->data_len < 1) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        return;
+    }
+
+    ipmb_get_link_stats(&stats);
+
+    switch (req->data[0]) {
+    case 0x00:
+        counters[counters_cnt++] = stats.rx_frames;
+        counters[counters_cnt++] = stats.rx_dropped;
+        counters[counters_cnt++] = stats.rx_hdr_chksum_err;
+        counters[counters_cnt++] = stats.rx_msg_chksum_err;
+        counters[counters_cnt++] = stats.client_notify_timeout;
+        break;
+    case 0x01:
+        counters[counters_cnt++] = stats.tx_requests;
+        counters[counters_cnt++] = stats.tx_responses;
+        counters[counters_cnt++] = stats.tx_retries;
+        counters[counters_cnt++] = stats.tx_failures;
+        counters[counters_cnt++] = stats.resp_unmatched;
+        counters[counters_cnt++] = stats.resp_late;
+        break;
+    case 0x02:
+        hist = stats.req_resp_hist;
+        break;
+    case 0x03:
+        hist = stats.tx_wait_hist;
+        break;
+    case 0x04:
+        counters[counters_cnt++] = stats.tx_arb_lost;
+        break;
+    case 0xFF:
+        ipmb_reset_link_stats();
+        memset(i2c_arb_lost_count, 0, sizeof(i2c_arb_lost_count));
+        memset(i2c_timeout_count, 0, sizeof(i2c_timeout_count));
+        memset(i2c_bus_err_count, 0, sizeof(i2c_bus_err_count));
+        memset(i2c_recovery_count, 0, sizeof(i2c_recovery_count));
+        break;
+    default:
+        if ((req->data[0] >= 0x10) && (req->data[0] < 0x10 + I2C_NUM_INTERFACE)) {
+            counters[counters_cnt++] = i2c_arb_lost_count[req->data[0] - 0x10];
+            counters[counters_cnt++] = i2c_timeout_count[req->data[0] - 0x10];
+            counters[counters_cnt++] = i2c_bus_err_count[req->data[0] - 0x10];
+            counters[counters_cnt++] = i2c_recovery_count[req->data[0] - 0x10];
+            break;
+        }
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        return;
+    }
+
+    for (uint8_t i = 0; i < counters_cnt; i++) {
+        rsp->data[len++] = counters[i] & 0xFF;
+        rsp->data[len++] = (counters[i] >> 8) & 0xFF;
+        rsp->data[len++] = (counters[i] >> 16) & 0xFF;
+        rsp->data[len++] = (counters[i] >> 24) & 0xFF;
+    }
+
+    if (hist) {
+        for (uint8_t i = 0; i < IPMB_HIST_BINS; i++) {
+            rsp->data[len++] = hist[i] & 0xFF;
+            rsp->data[len++] = (hist[i] >> 8) & 0xFF;
+        }
+    }
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
@@ -470,6 +470,9 @@
 #define IPMI_CUSTOM_CMD_GET_GIT_HASH                            0x02
 #define IPMI_CUSTOM_CMD_WRITE_CLOCK_CONFIG                      0x03
 #define IPMI_CUSTOM_CMD_READ_CLOCK_CONFIG                       0x04
+#define IPMI_CUSTOM_CMD_GET_IPMB_STATS                          0x05
+#define IPMI_CUSTOM_CMD_GET_SENSOR_HISTORY                      0x06
+#define IPMI_CUSTOM_CMD_GET_SENSOR_READINGS                     0x07
 /**
  * @}
  */
@@ -535,9 +538,123 @@ typedef void (* t_req_handler)(ipmi_msg * req, ipmi_msg * resp);
 typedef struct{
     uint8_t netfn;                 /**< Net Function */
     uint8_t cmd;                   /**< Command */
+    uint8_t flags;                 /**< Handler flags (IPMI_HANDLER_FLAG_*) */
     t_req_handler req_handler;     /**< IPMI handler function */
 } t_req_handler_record;
 
+/**
+ * @brief Handler runs on the deferred worker task instead of the IPMI dispatcher
+ */
+#define IPMI_HANDLER_FLAG_DEFERRED      (1 << 0)
+
+/**
+ * @brief Handler has side effects, its response is replayed to a retransmitted request instead of running it again
+ */
+#define IPMI_HANDLER_FLAG_REPLAY        (1 << 1)
+
+/**
+ * @brief Maximum count of deferred requests waiting for the worker task
+ */
+#define IPMI_DEFERRED_QUEUE_LEN         2
+
+/**
+ * @brief Number of responses kept to be replayed to retransmitted requests (only the handlers flagged with #IPMI_HANDLER_FLAG_REPLAY)
+ */
+#define IPMI_REPLAY_CACHE_LEN           4
+
+/**
+ * @brief Time window in which a request with the same requester, sequence number, NetFN, CMD and data is considered a retransmission
+ *
+ * Must be shorter than the sequence number expiration interval (5 seconds in the IPMB specification)
+ */
+#define IPMI_REPLAY_CACHE_TIMEOUT       (2000/portTICK_PERIOD_MS)
+
+/**
+ * @brief Maximum count of platform events waiting to be delivered
+ */
+#define IPMI_EVENT_OUTBOX_LEN           16
+
+/**
+ * @brief Platform Event request data length
+ */
+#define IPMI_EVENT_DATA_LEN             7
+
+/**
+ * @brief Delay before the first retry of an event which wasn't answered (doubled on each new retry)
+ */
+#define IPMI_EVENT_RETRY_BASE           (100/portTICK_PERIOD_MS)
+
+/**
+ * @brief Maximum delay between event retries
+ */
+#define IPMI_EVENT_RETRY_MAX            (5000/portTICK_PERIOD_MS)
+
+/**
+ * @brief Delivery attempts before a sensor event is dropped (hot swap events are retried until they're delivered)
+ */
+#define IPMI_EVENT_MAX_RETRIES          8
+
+/**
+ * @brief Platform event delivery priorities (lower value is sent first)
+ */
+typedef enum {
+    IPMI_EVENT_PRIO_HOTSWAP = 0,   /**< Hot swap sensor state changes */
+    IPMI_EVENT_PRIO_SENSOR         /**< Threshold and other sensor events */
+} ipmi_event_prio;
+
+/**
+ * @brief Platform event outbox entry
+ */
+typedef struct {
+    uint8_t used;                  /**< Entry holds an event waiting to be delivered */
+    uint8_t in_flight;             /**< Event is being sent right now, it can't be coalesced */
+    uint8_t priority;              /**< Delivery priority @see ipmi_event_prio */
+    uint8_t retries;               /**< Delivery attempts which weren't answered */
+    uint32_t order;                /**< Arrival order, used to send events with the same priority in FIFO order */
+    TickType_t last_try;           /**< Tick count of the last delivery attempt */
+    TickType_t delay;              /**< Ticks to wait after last_try before the next attempt */
+    uint8_t data[IPMI_EVENT_DATA_LEN]; /**< Platform Event request data */
+} ipmi_event_entry;
+
+/**
+ * @brief Response replay cache entry
+ */
+typedef struct {
+    uint8_t valid;                 /**< Entry holds a response */
+    uint8_t rq_addr;               /**< Requester slave address (rqSA) */
+    uint8_t seq;                   /**< Request sequence number */
+    uint8_t netfn;                 /**< Request Net Function */
+    uint8_t cmd;                   /**< Request Command */
+    uint8_t req_len;               /**< Request data length */
+    uint16_t req_sum;              /**< Fletcher-16 checksum of the request data */
+    TickType_t timestamp;          /**< Tick count when the response was sent */
+    uint8_t completion_code;       /**< Response completion code */
+    uint8_t data_len;              /**< Response data length */
+    uint8_t data[IPMI_MSG_MAX_LENGTH]; /**< Response data */
+} ipmi_replay_entry;
+
+/**
+ * @brief Number of request NetFN codes (6-bit NetFN, even values only)
+ */
+#define IPMI_NETFN_COUNT        32
+
+/**
+ * @brief Position of a request NetFN in the dispatch index
+ */
+#define IPMI_NETFN_SLOT(netfn)  ((netfn) >> 1)
+
+/**
+ * @brief Command dispatch index for a single NetFN
+ *
+ * Maps each command between first_cmd and (first_cmd + cmd_count - 1) to its record in the .ipmi_handlers section,
+ * so the handler lookup doesn't depend on how many handlers are linked in the firmware.
+ */
+typedef struct {
+    uint8_t first_cmd;             /**< Lowest command code registered for this NetFN */
+    uint8_t cmd_count;             /**< Size of the command range (0 if the NetFN has no handlers) */
+    uint8_t *index;                /**< Handler record position + 1 for each command in range (0 = no handler) */
+} ipmi_netfn_dispatch;
+
 /**
  * @brief Pointer to IPMI Handler record list start byte stored in ROM
  */
@@ -566,7 +683,40 @@ extern const t_req_handler_record *_eipmi_handlers;
  */
 #define IPMI_HANDLER(name, netfn_id, cmd_id, args...)                   \
     void ipmi_handler_##netfn_id##__##cmd_id##_f(args);                 \
-    const t_req_handler_record __attribute__ ((section (".ipmi_handlers"))) ipmi_handler_##netfn_id##__##cmd_id##_s = { .req_handler = ipmi_handler_##netfn_id##__##cmd_id##_f , .netfn = netfn_id, .cmd = cmd_id }; \
+    const t_req_handler_record __attribute__ ((section (".ipmi_handlers"))) ipmi_handler_##netfn_id##__##cmd_id##_s = { .req_handler = ipmi_handler_##netfn_id##__##cmd_id##_f , .netfn = netfn_id, .cmd = cmd_id, .flags = 0 }; \
+    void ipmi_handler_##netfn_id##__##cmd_id##_f(args)
+
+/**
+ * @brief Macro to implement IPMI handler functions which may take long to complete
+ *
+ * Same as #IPMI_HANDLER, but the handler is run by the lower priority deferred worker task (see #IPMIDeferredTask), so slow
+ * commands (flash writes, EEPROM writes, I2C transfers on external buses) don't delay the fast ones polled by the MCH.
+ * The response is sent when the handler returns.
+ */
+#define IPMI_DEFERRED_HANDLER(name, netfn_id, cmd_id, args...)          \
+    void ipmi_handler_##netfn_id##__##cmd_id##_f(args);                 \
+    const t_req_handler_record __attribute__ ((section (".ipmi_handlers"))) ipmi_handler_##netfn_id##__##cmd_id##_s = { .req_handler = ipmi_handler_##netfn_id##__##cmd_id##_f , .netfn = netfn_id, .cmd = cmd_id, .flags = IPMI_HANDLER_FLAG_DEFERRED }; \
+    void ipmi_handler_##netfn_id##__##cmd_id##_f(args)
+
+/**
+ * @brief Macro to implement IPMI handler functions which have side effects
+ *
+ * Same as #IPMI_HANDLER, but the response is kept in the replay cache: when the MCH retransmits the request (our response
+ * was lost or late), it gets the same response and the handler isn't run again.
+ */
+#define IPMI_REPLAYED_HANDLER(name, netfn_id, cmd_id, args...)          \
+    void ipmi_handler_##netfn_id##__##cmd_id##_f(args);                 \
+    const t_req_handler_record __attribute__ ((section (".ipmi_handlers"))) ipmi_handler_##netfn_id##__##cmd_id##_s = { .req_handler = ipmi_handler_##netfn_id##__##cmd_id##_f , .netfn = netfn_id, .cmd = cmd_id, .flags = IPMI_HANDLER_FLAG_REPLAY }; \
+    void ipmi_handler_##netfn_id##__##cmd_id##_f(args)
+
+/**
+ * @brief Macro to implement IPMI handler functions which may take long to complete and have side effects
+ *
+ * Combines #IPMI_DEFERRED_HANDLER and #IPMI_REPLAYED_HANDLER.
+ */
+#define IPMI_DEFERRED_REPLAYED_HANDLER(name, netfn_id, cmd_id, args...) \
+    void ipmi_handler_##netfn_id##__##cmd_id##_f(args);                 \
+    const t_req_handler_record __attribute__ ((section (".ipmi_handlers"))) ipmi_handler_##netfn_id##__##cmd_id##_s = { .req_handler = ipmi_handler_##netfn_id##__##cmd_id##_f , .netfn = netfn_id, .cmd = cmd_id, .flags = IPMI_HANDLER_FLAG_DEFERRED | IPMI_HANDLER_FLAG_REPLAY }; \
     void ipmi_handler_##netfn_id##__##cmd_id##_f(args)
 
 /* Function Prototypes */
@@ -577,17 +727,58 @@ extern const t_req_handler_record *_eipmi_handlers;
  * This task handles all the incoming IPMI messages previously decoded by IPMB tasks.
  * Here the netfunction and commands are analyzed and the respective handler function is called.
  *
+ * A request matching a response sent less than #IPMI_REPLAY_CACHE_TIMEOUT ago (same requester, sequence number, NetFN and CMD) is a
+ * retransmission from a requester which missed our response: the stored response is sent again and the handler isn't called.
+ *
+ * Handlers registered with #IPMI_DEFERRED_HANDLER are passed to #IPMIDeferredTask instead. If the same request is retransmitted while
+ * it's still being handled, it's answered with #IPMI_CC_COMMAND_IN_PROGRESS; if the worker backlog is full, with #IPMI_CC_NODE_BUSY.
+ *
  * @param pvParameters Pointer to parameters buffer passed to this task in initialization
  */
 void IPMITask ( void *pvParameters );
 
+/**
+ * @brief IPMI deferred worker task
+ *
+ * Runs the slow handlers (registered with #IPMI_DEFERRED_HANDLER) one at a time, in arrival order, and sends their responses.
+ *
+ * @param pvParameters Pointer to parameters buffer passed to this task in initialization
+ */
+void IPMIDeferredTask ( void *pvParameters );
+
+/**
+ * @brief Platform event delivery task
+ *
+ * Sends the events queued by #ipmi_event_send, hot swap events first and then the others in arrival order. Events which aren't answered
+ * are retried with an exponential backoff (#IPMI_EVENT_RETRY_BASE up to #IPMI_EVENT_RETRY_MAX), while the other events go ahead.
+ * The hot swap events of a given sensor are an exception: they're always delivered in order, so a newer M-state transition
+ * waits for the older ones to be answered.
+ *
+ * @param pvParameters Pointer to parameters buffer passed to this task in initialization
+ */
+void IPMIEventTask ( void *pvParameters );
+
 /**
  * @brief Initializes the IPMI Dispatcher
  *
- * This function initializes the IPMB Layer, registers the RX queue for incoming requests and creates the IPMI task
+ * This function initializes the IPMB Layer, registers the RX queue for incoming requests and creates the IPMI dispatcher, the deferred worker
+ * and the event delivery tasks
  */
 void ipmi_init ( void );
 
+/**
+ * @brief Builds the IPMI handler dispatch index
+ *
+ * Scans the .ipmi_handlers section once and fills a two-level NetFN -> CMD table, allowing #ipmi_retrieve_handler to find
+ * any handler in constant time.
+ *
+ * Two handlers declared with the same NetFN and CMD tokens already fail to link, since their records share a symbol name.
+ * Duplicates spelled differently (e.g. a macro and its numeric value) can only be detected here, and trip a configASSERT.
+ *
+ * @note Called by #ipmi_init before the IPMI task is created
+ */
+void ipmi_dispatch_init ( void );
+
 /**
  * @brief Finds a handler associated with a given netfunction and command.
  *
@@ -599,17 +790,29 @@ void ipmi_init ( void );
 t_req_handler ipmi_retrieve_handler(uint8_t netfn, uint8_t cmd);
 
 /**
- * @brief Sends an event message (Platform Event) via IPMI
+ * @brief Finds the handler record associated with a given netfunction and command.
+ *
+ * @param netfn 8-bit network function code
+ * @param cmd 8-bit command code
+ *
+ * @return Pointer to the handler record (holding the handler function and its flags) or NULL if there's no handler
+ */
+const t_req_handler_record * ipmi_retrieve_record(uint8_t netfn, uint8_t cmd);
+
+/**
+ * @brief Queues an event message (Platform Event) to be sent via IPMI
+ *
+ * The event is built right away and put in the event outbox, it's delivered by #IPMIEventTask so the caller never waits for the IPMB.
+ * A sensor (not hot swap) event cancels a pending event of the opposite direction for the same sensor and offset, since the event receiver
+ * didn't learn about it yet; a duplicated pending event is ignored.
  *
  * @param sensor          Pointer to sensor information struct
  * @param assert_deassert Evetn transition direction (0) for assertion, (1) for Deassertion
  * @param evData          Pointer to event message buffer
  * @param length          Event message buffer len (max len = 3)
  *
- * @return ipmb_error
- *
- * @see sdr.h
- * @see ipmb.h
+ * @retval ipmb_error_success The event was queued (or coalesced with a pending one)
+ * @retval ipmb_error_failure The event outbox is full
  */
 ipmb_error ipmi_event_send( sensor_t * sensor, uint8_t assert_deassert, uint8_t *evData, uint8_t length);
 
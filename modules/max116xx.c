@@ -129,3 +129,47 @@ mmc_err max116xx_read_bip(uint8_t chip_id, int16_t data[], uint8_t samples)
 
     return MMC_OK;
 }
+
+static void max116xx_convert(int16_t data[], uint8_t samples, bool bipolar)
+{
+    /*
+     * Convert from big endian to little endian
+     */
+    for (uint8_t i = 0; i < samples; i++)
+    {
+        data[i] = ((data[i] >> 8) & 0x00FF) | ((data[i] << 8) & 0x0300);
+
+        /*
+         * Sign extend if MSB = 1
+         */
+        if (bipolar && (data[i] & (1 << 9))) {
+            data[i] |= 0xFC00;
+        }
+    }
+}
+
+mmc_err max116xx_config_read(uint8_t chip_id, const max116xx_cfg* cfg, int16_t data[], uint8_t samples)
+{
+    uint8_t setup_cfg[2] = {0};
+    i2c_op_t ops[2] = {
+        { .chip_id = chip_id, .flags = I2C_OP_WRITE, .data = setup_cfg, .len = sizeof(setup_cfg) },
+        { .chip_id = chip_id, .flags = I2C_OP_READ, .data = (uint8_t*)data, .len = (samples * 2) },
+    };
+    mmc_err err;
+
+    if ((cfg == NULL) || (data == NULL)) {
+        return MMC_INVALID_ARG_ERR;
+    }
+
+    setup_cfg[0] = 0x80 | cfg->ref_sel | cfg->clk_sel | cfg->pol_sel | 0b10;
+    setup_cfg[1] = cfg->scan_mode | (cfg->channel_sel << 1) | cfg->diff_mode;
+
+    /* Configuration and conversion readout in a row, no other transfer can reconfigure the chip in between */
+    err = i2c_batch(ops, 2, pdMS_TO_TICKS(10));
+
+    if (ops[1].status == MMC_OK) {
+        max116xx_convert(data, samples, (cfg->pol_sel == MAX116XX_BIPOLAR));
+    }
+
+    return err;
+}
@@ -112,4 +112,16 @@ mmc_err max116xx_read_uni(uint8_t chip_id, int16_t data[], uint8_t samples);
  */
 mmc_err max116xx_read_bip(uint8_t chip_id, int16_t data[], uint8_t samples);
 
+/**
+ * @brief Configure the ADC, then convert and read single or multiple channels under a single bus acquisition
+ *
+ * @param[in]  chip_id Chip ID to communicate
+ * @param[in]  cfg     max116xx_cfg struct with the configuration, its polarity selects the samples range
+ * @param[out] data    Array containing the samples
+ * @param[in]  samples Number of samples requested
+ *
+ * @return MMC_OK if success, an error code otherwise
+ */
+mmc_err max116xx_config_read(uint8_t chip_id, const max116xx_cfg* cfg, int16_t data[], uint8_t samples);
+
 #endif
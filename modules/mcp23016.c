@@ -132,19 +132,30 @@ mmc_err mcp23016_write_port( uint8_t port_num, uint8_t data )
 
 mmc_err mcp23016_write_pin( uint8_t port_num, uint8_t pin, bool data )
 {
-    uint8_t output = 0;
-    mmc_err err;
+    uint8_t i2c_addr;
+    uint8_t i2c_id;
+    uint8_t reg = MCP23016_GP_REG + port_num;
+    uint8_t port[2] = {0};
+    uint8_t cmd_data[2];
+    mmc_err err = MMC_IO_ERR;
 
-    err = mcp23016_read_port( port_num, &output );
+    /* Read-modify-write of the port under a single bus acquisition, so it can't interleave with another task's */
+    if( !i2c_take_by_chipid( CHIP_ID_MCP23016, &i2c_addr, &i2c_id, pdMS_TO_TICKS(10)) ) {
+        return MMC_TIMEOUT_ERR;
+    }
 
-    if (err != MMC_OK) {
-        return err;
+    if (xI2CMasterWriteRead(i2c_id, i2c_addr, &reg, 1, port, sizeof(port)) == sizeof(port)) {
+        cmd_data[0] = reg;
+        cmd_data[1] = ( port[0] & ~( 1 << pin ) ) | ( data << pin );
+
+        if (xI2CMasterWrite(i2c_id, i2c_addr, cmd_data, sizeof(cmd_data)) == sizeof(cmd_data)) {
+            err = MMC_OK;
+        }
     }
 
-    output &= ~( 1 << pin );
-    output |= ( data << pin );
+    i2c_give(i2c_id);
 
-    return mcp23016_write_port( port_num, output );
+    return err;
 }
 
 /* Polarity Control */
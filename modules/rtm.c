@@ -57,6 +57,9 @@ void RTM_Manage( void * Parameters )
     /* Start with RTM payload disabled */
     rtm_disable_payload_power();
 
+    /* Don't read the RTM sensors until the board is detected */
+    sdr_disable_sensors( SDR_ENTITY_RTM );
+
     for ( ;; ) {
         vTaskDelay(pdMS_TO_TICKS(500));
 
@@ -108,10 +111,10 @@ void RTM_Manage( void * Parameters )
                 }
 
                 /* Activate RTM sensors in the SDR table */
-                //sdr_activate_sensors(); /* Not implemented yet */
+                sdr_activate_sensors( SDR_ENTITY_RTM );
 
             } else if ( ps_new_state == HOTSWAP_STATE_URTM_ABSENT ) {
-                //sdr_disable_sensors(); /* Not implemented yet */
+                sdr_disable_sensors( SDR_ENTITY_RTM );
 
                 printf("[RTM] Rear Board disconnected!\n");
 
@@ -158,7 +161,7 @@ void rtm_manage_init( void )
 
 /* Set Power Level Request handler */
 
-IPMI_HANDLER(ipmi_picmg_set_power_level, NETFN_GRPEXT, IPMI_PICMG_CMD_SET_POWER_LEVEL, ipmi_msg *req, ipmi_msg *rsp )
+IPMI_REPLAYED_HANDLER(ipmi_picmg_set_power_level, NETFN_GRPEXT, IPMI_PICMG_CMD_SET_POWER_LEVEL, ipmi_msg *req, ipmi_msg *rsp )
 {
     int len = rsp->data_len = 0;
     uint8_t fru_id = req->data[1];
@@ -30,11 +30,19 @@
 #include "task.h"
 #include "semphr.h"
 
+/* C Standard includes */
+#include <stddef.h>
+#include <string.h>
+
 /* Project Includes */
 #include "sdr.h"
 #include "sensors.h"
 #include "ipmi.h"
 #include "fpga_spi.h"
+#ifdef MODULE_SENSORS
+#include "sensor_sched.h"
+#include "sensor_filter.h"
+#endif
 
 volatile uint8_t sdr_count = 0;
 
@@ -44,25 +52,47 @@ sensor_t *sdr_tail = NULL;
 static uint16_t reservationID;
 static uint32_t sdr_change_count;
 
-uint8_t compare_val(uint8_t val1, uint8_t val2, uint8_t comp, uint8_t sign)
+/* Get Device SDR image: the records back to back, as sent to the MCH, and the offset of each one (plus the image end) */
+static uint16_t * sdr_image_offset;
+static uint8_t * sdr_image;
+static uint32_t sdr_image_change_count;
+
+/* Repository entries indexed by record ID (which is also the sensor number), in the same order as the sdr_head list */
+static sensor_t ** sdr_index;
+static uint16_t sdr_index_size;
+
+/* Repository entries hashed by the address of their record, for find_sensor_by_sdr(). The records are const (most of them sit
+ * in flash), so the link from a record back to its entry is kept here: open addressing, twice the index size */
+static sensor_t ** sdr_record_table;
+
+#define SDR_RECORD_SLOT(sdr, size)      ( ( (uintptr_t) (sdr) >> 2 ) % (size) )
+
+/* Set once the MCH has read the repository: the record IDs, which are also the sensor numbers, can't change anymore */
+static bool sdr_announced;
+
+/* Sensors of each monitor task, linked through sensor_t::task_next */
+typedef struct {
+    TaskHandle_t * monitor_task;
+    sensor_t * head;
+    sensor_t * tail;
+} sdr_task_list_t;
+
+static sdr_task_list_t sdr_task_lists[SDR_MAX_MONITOR_TASKS];
+
+/* Held by the monitor tasks walking their list, so a sensor isn't freed under them */
+static SemaphoreHandle_t sdr_task_lists_mutex;
+
+static sdr_task_list_t * sdr_find_task_list( TaskHandle_t * monitor_task )
 {
-    if(sign == SIGNED) {
-        switch(comp) {
-        case UPPER_EQ:
-            return (((int8_t)val1) >= ((int8_t)val2));
-        case LOWER_EQ:
-            return (((int8_t)val1) <= ((int8_t)val2));
-        }
-    } else {
-        switch(comp){
-        case UPPER_EQ:
-            return ((val1) >= (val2));
-        case LOWER_EQ:
-            return ((val1) <= (val2));
+    uint8_t i;
+
+    for ( i = 0; i < SDR_MAX_MONITOR_TASKS; i++ ) {
+        if ( sdr_task_lists[i].monitor_task == monitor_task ) {
+            return &sdr_task_lists[i];
         }
     }
 
-    return 0x00;
+    return NULL;
 }
 
 size_t sdr_get_size_by_type(SDR_TYPE type)
@@ -115,6 +145,11 @@ void sensor_init( void )
 #if defined(MODULE_INA3221_CURRENT) || defined(MODULE_INA3221_VOLTAGE)
     ina3221_init();
 #endif
+
+#ifdef MODULE_SENSORS
+    /* Start polling the sensors of the drivers registered above */
+    sensor_sched_init();
+#endif
 }
 
 void sdr_init( void )
@@ -122,6 +157,9 @@ void sdr_init( void )
     sdr_head = NULL;
     sdr_tail = NULL;
 
+    sdr_task_lists_mutex = xSemaphoreCreateMutex();
+    configASSERT( sdr_task_lists_mutex );
+
     /* Populate AMC SDR Device Locator Record */
     sdr_head = sdr_insert_entry( TYPE_12, (void *) &SDR0, NULL, 0, 0 );
 #ifdef MODULE_RTM
@@ -129,11 +167,83 @@ void sdr_init( void )
 #endif
 }
 
+static void sdr_record_table_add( sensor_t ** table, uint16_t size, sensor_t * entry )
+{
+    uint16_t i;
+
+    for ( i = SDR_RECORD_SLOT( entry->sdr, size ); table[i] != NULL; i = ( i + 1 ) % size ) {}
+
+    table[i] = entry;
+}
+
+/**
+ * @brief Doubles the capacity of the SDR index
+ *
+ * @return false if the repository is full or there's no memory left
+ */
+static bool sdr_index_grow( void )
+{
+    uint16_t new_size = sdr_index_size ? ( sdr_index_size * 2 ) : SDR_INDEX_INITIAL_SIZE;
+    sensor_t ** new_index;
+    sensor_t ** old_index;
+    sensor_t ** new_table;
+    sensor_t ** old_table;
+    uint8_t i;
+
+    if ( new_size > SDR_MAX_ENTRIES ) {
+        new_size = SDR_MAX_ENTRIES;
+    }
+
+    if ( new_size <= sdr_index_size ) {
+        return false;
+    }
+
+    new_index = pvPortMalloc( new_size * sizeof(sensor_t *) );
+    new_table = pvPortMalloc( 2 * new_size * sizeof(sensor_t *) );
+
+    if ( ( new_index == NULL ) || ( new_table == NULL ) ) {
+        vPortFree( new_index );
+        vPortFree( new_table );
+        return false;
+    }
+
+    memset( new_table, 0, 2 * new_size * sizeof(sensor_t *) );
+
+    if ( sdr_index ) {
+        memcpy( new_index, sdr_index, sdr_count * sizeof(sensor_t *) );
+    }
+    for ( i = 0; i < sdr_count; i++ ) {
+        sdr_record_table_add( new_table, 2 * new_size, new_index[i] );
+    }
+
+    taskENTER_CRITICAL();
+    old_index = sdr_index;
+    old_table = sdr_record_table;
+    sdr_index = new_index;
+    sdr_record_table = new_table;
+    sdr_index_size = new_size;
+    taskEXIT_CRITICAL();
+
+    vPortFree( old_index );
+    vPortFree( old_table );
+
+    return true;
+}
+
 sensor_t * sdr_insert_entry( SDR_TYPE type, void * sdr, TaskHandle_t *monitor_task, uint8_t diag_id, uint8_t chipid )
 {
     uint8_t sdr_len = sdr_get_size_by_type(type);
 
+    if ( ( sdr_count >= sdr_index_size ) && !sdr_index_grow() ) {
+        return NULL;
+    }
+
     sensor_t * entry = pvPortMalloc( sizeof(sensor_t) );
+
+    if ( entry == NULL ) {
+        return NULL;
+    }
+
     memset( entry, 0, sizeof(sensor_t) );
 
     entry->num = sdr_count;
@@ -150,13 +260,39 @@ sensor_t * sdr_insert_entry( SDR_TYPE type, void * sdr, TaskHandle_t *monitor_ta
     entry->event_scan = 0xC0; /* Start with sensor enabled */
 
     /* Link the sdr list */
+    entry->next = NULL;
     if (sdr_tail) {
         sdr_tail->next = entry;
+    } else {
+        sdr_head = entry;
     }
     sdr_tail = entry;
-    entry->next = NULL;
 
+    /* Link the monitor task list, the first sensor of a task takes a free slot */
+    if ( monitor_task ) {
+        sdr_task_list_t * list = sdr_find_task_list( monitor_task );
+
+        if ( list == NULL ) {
+            list = sdr_find_task_list( NULL );
+            configASSERT( list );
+            list->monitor_task = monitor_task;
+        }
+
+        entry->task_next = NULL;
+        if ( list->tail ) {
+            list->tail->task_next = entry;
+        } else {
+            list->head = entry;
+        }
+        list->tail = entry;
+    }
+
+    taskENTER_CRITICAL();
+    sdr_index[entry->num] = entry;
+    sdr_record_table_add( sdr_record_table, 2 * sdr_index_size, entry );
     sdr_count++;
+    taskEXIT_CRITICAL();
+
     sdr_change_count++;
 
     return entry;
@@ -177,65 +313,139 @@ sensor_t * sdr_add_settings(uint8_t chipid, void * settings)
 
 sensor_t * find_sensor_by_sdr( void * sdr )
 {
-    sensor_t * cur;
-
-    for ( cur = sdr_head; cur != NULL; cur = cur->next ) {
-        if (cur->sdr == sdr) {
-            return cur;
+    sensor_t * entry = NULL;
+    uint16_t size;
+    uint16_t i;
+
+    /* The table is reallocated when an insertion grows the index */
+    taskENTER_CRITICAL();
+    if ( sdr_record_table ) {
+        size = 2 * sdr_index_size;
+        for ( i = SDR_RECORD_SLOT( sdr, size ); sdr_record_table[i] != NULL; i = ( i + 1 ) % size ) {
+            if ( sdr_record_table[i]->sdr == sdr ) {
+                entry = sdr_record_table[i];
+                break;
+            }
         }
     }
-    return NULL;
+    taskEXIT_CRITICAL();
 
+    return entry;
 }
 
-sensor_t * find_sensor_by_id( uint8_t id )
+sensor_t * sdr_task_sensors( TaskHandle_t * monitor_task )
 {
-    sensor_t * cur;
+    sdr_task_list_t * list;
 
-    for ( cur = sdr_head; cur != NULL; cur = cur->next ) {
-        if (cur->num == id) {
-            return cur;
-        }
+    if ( monitor_task == NULL ) {
+        return NULL;
     }
-    return NULL;
+
+    list = sdr_find_task_list( monitor_task );
+
+    return list ? list->head : NULL;
 }
 
-void sdr_remove_entry( sensor_t * entry )
+void sdr_task_lists_take( void )
 {
-    sensor_t * cur = sdr_head;
-    sensor_t * prev = NULL;
+    xSemaphoreTake( sdr_task_lists_mutex, portMAX_DELAY );
+}
 
-    if (entry == sdr_head) {
-        sdr_pop();
+void sdr_task_lists_give( void )
+{
+    xSemaphoreGive( sdr_task_lists_mutex );
+}
+
+sensor_t * find_sensor_by_id( uint8_t id )
+{
+    if ( id >= sdr_count ) {
+        return NULL;
     }
 
-    while (cur != entry) {
-        prev = cur;
-        cur = cur->next;
-        if (cur == NULL) {
-            /* We reached the end of the list and didn't find the entry */
-            return;
-        }
+    return sdr_index[id];
+}
+
+bool sdr_remove_entry( sensor_t * entry )
+{
+    sensor_t * prev;
+    uint8_t i;
+
+    if ( ( entry == NULL ) || ( find_sensor_by_id( entry->num ) != entry ) ) {
+        return false;
+    }
+
+    /* The following sensors would be renumbered under the MCH, which has cached the records */
+    if ( sdr_announced ) {
+        return false;
+    }
+
+    /* The list follows the index order, so the previous entry is found right away */
+    prev = ( entry->num > 0 ) ? sdr_index[entry->num - 1] : NULL;
+
+    sdr_task_lists_take();
+
+    /* Relink the list */
+    if ( prev ) {
+        prev->next = entry->next;
+    } else {
+        sdr_head = entry->next;
+    }
+    if ( entry == sdr_tail ) {
+        sdr_tail = prev;
     }
 
-    /* Relink the table */
-    prev->next = cur->next;
+    /* Unlink it from its monitor task list, those are short */
+    if ( entry->task_handle ) {
+        sdr_task_list_t * list = sdr_find_task_list( entry->task_handle );
+        sensor_t ** link;
+
+        if ( list ) {
+            prev = NULL;
+            for ( link = &list->head; *link != NULL; link = &(*link)->task_next ) {
+                if ( *link == entry ) {
+                    *link = entry->task_next;
+                    if ( list->tail == entry ) {
+                        list->tail = prev;
+                    }
+                    break;
+                }
+                prev = *link;
+            }
+        }
+    }
 
+    /* Close the gap, record IDs must stay contiguous as each one is followed by the next in Get Device SDR */
+    taskENTER_CRITICAL();
+    for ( i = entry->num; i < sdr_count - 1; i++ ) {
+        sdr_index[i] = sdr_index[i + 1];
+        sdr_index[i]->num = i;
+    }
     sdr_count--;
+
+    /* Removals are rare and the table short, it is simply rebuilt */
+    memset( sdr_record_table, 0, 2 * sdr_index_size * sizeof(sensor_t *) );
+    for ( i = 0; i < sdr_count; i++ ) {
+        sdr_record_table_add( sdr_record_table, 2 * sdr_index_size, sdr_index[i] );
+    }
+    taskEXIT_CRITICAL();
+
     sdr_change_count++;
 
-    /* Free the entry */
-    vPortFree(cur);
+    sdr_task_lists_give();
+
+    /* Free the entry, no monitor task can reach it anymore */
+    vPortFree(entry->history);
+    vPortFree(entry->filter);
+    vPortFree(entry->sched);
+    vPortFree(entry);
+
+    return true;
 }
 
 void sdr_pop( void )
 {
-    sensor_t * new_head;
-
     if ( sdr_head ) {
-        new_head = sdr_head->next;
-        vPortFree( sdr_head );
-        sdr_head = new_head;
+        sdr_remove_entry( sdr_head );
     }
 }
 
@@ -249,6 +459,112 @@ void sensor_disable(sensor_t *sensor)
     sensor->event_scan = 0x00;
 }
 
+void sdr_activate_sensors( uint8_t entity_id )
+{
+    sensor_t * sensor;
+
+    for ( sensor = sdr_head; sensor != NULL; sensor = sensor->next ) {
+        if ( ( sensor->sdr_type != TYPE_01 ) || ( ((SDR_type_01h_t *) sensor->sdr)->entityID != entity_id ) ) {
+            continue;
+        }
+        if ( sensor->event_scan & SENSOR_SCAN_ENABLED ) {
+            continue;
+        }
+
+        /* Nothing was read while it was disabled, the first reading decides which events to send again */
+        sensor->asserted_events = 0;
+#ifdef MODULE_SENSORS
+        sensor_filter_reset( sensor );
+#endif
+        sensor_enable( sensor );
+    }
+}
+
+void sdr_disable_sensors( uint8_t entity_id )
+{
+    sensor_t * sensor;
+
+    for ( sensor = sdr_head; sensor != NULL; sensor = sensor->next ) {
+        if ( ( sensor->sdr_type == TYPE_01 ) && ( ((SDR_type_01h_t *) sensor->sdr)->entityID == entity_id ) ) {
+            sensor_disable( sensor );
+        }
+    }
+}
+
+/**
+ * @brief Copies a record as returned by Get Device SDR, with the fields only known at run time filled in
+ *
+ * @param entry Repository entry
+ * @param dst Destination, at least sensor_t::sdr_length bytes long
+ */
+static void sdr_serialize_record( sensor_t * entry, uint8_t * dst )
+{
+    memcpy( dst, entry->sdr, entry->sdr_length );
+
+    dst[0] = entry->num;
+    dst[5] = ipmb_addr;
+
+    switch (dst[3]) {
+    case TYPE_01:
+    case TYPE_02:
+        dst[7] = entry->num;
+        dst[9] = entry->entityinstance;
+        break;
+    case TYPE_11:
+    case TYPE_12:
+        dst[13] = entry->entityinstance;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Rebuilds the Get Device SDR image if the repository changed since it was built
+ *
+ * @return false if there's no memory left for the image
+ */
+static bool sdr_image_update( void )
+{
+    uint16_t * offset;
+    uint16_t size = 0;
+    uint8_t count;
+    uint8_t i;
+
+    if ( sdr_image && ( sdr_image_change_count == sdr_change_count ) ) {
+        return true;
+    }
+
+    /* The repository must not change while it's copied */
+    vTaskSuspendAll();
+
+    count = sdr_count;
+    for ( i = 0; i < count; i++ ) {
+        size += sdr_index[i]->sdr_length;
+    }
+
+    vPortFree( sdr_image_offset );
+    sdr_image = NULL;
+
+    sdr_image_offset = pvPortMalloc( ( count + 1 ) * sizeof(uint16_t) + size );
+
+    if ( sdr_image_offset ) {
+        offset = sdr_image_offset;
+        sdr_image = (uint8_t *) &offset[count + 1];
+
+        offset[0] = 0;
+        for ( i = 0; i < count; i++ ) {
+            sdr_serialize_record( sdr_index[i], &sdr_image[offset[i]] );
+            offset[i + 1] = offset[i] + sdr_index[i]->sdr_length;
+        }
+        sdr_image_change_count = sdr_change_count;
+    }
+
+    xTaskResumeAll();
+
+    return ( sdr_image != NULL );
+}
+
 /******************************/
 /* IPMI SDR Commands handlers */
 /******************************/
@@ -256,6 +572,8 @@ void sensor_disable(sensor_t *sensor)
 IPMI_HANDLER(ipmi_se_get_sdr_info, NETFN_SE, IPMI_GET_DEVICE_SDR_INFO_CMD, ipmi_msg *req, ipmi_msg *rsp) {
     int len = rsp->data_len = 0;
 
+    sdr_announced = true;
+
     if (req->data_len == 0 || req->data[0] == 0) {
         /* Return number of sensors only (minus the dev locator fields) */
 #ifdef MODULE_RTM
@@ -296,7 +614,7 @@ uint8_t event_receiver_lun = 0x00;
 IPMI_HANDLER(ipmi_se_set_event_receiver, NETFN_SE, IPMI_SET_EVENT_RECEIVER_CMD, ipmi_msg *req, ipmi_msg *rsp)
 {
     /* Update the event receiver address (even if its 0xFF,
-       the checking will be done in check_sensor_event function) */
+       the checking will be done when the events are sent) */
     event_receiver_addr = req->data[0];
     event_receiver_lun = req->data[1];
 
@@ -335,6 +653,8 @@ IPMI_HANDLER(ipmi_se_get_sdr, NETFN_SE, IPMI_GET_DEVICE_SDR_CMD, ipmi_msg *req,
 
     rsp->completion_code = IPMI_CC_OK;
 
+    sdr_announced = true;
+
     /* Reservation ID check */
     if (reservationID != recv_reserv_id) {
         rsp->data_len = 0;
@@ -360,33 +680,16 @@ IPMI_HANDLER(ipmi_se_get_sdr, NETFN_SE, IPMI_GET_DEVICE_SDR_CMD, ipmi_msg *req,
         rsp->data[len++] = (record_id + 1) >> 8; /* next record ID */
     }
 
-    uint8_t tmp_c, index;
-    uint8_t * pSDR = (uint8_t *) cur_sensor->sdr;
-    uint8_t sdr_type = pSDR[3];
-
-    for (uint8_t i = 0; i < size; i++) {
-        index = i + offset;
-        tmp_c = pSDR[index];
+    if ( sdr_image_update() ) {
+        memcpy( &rsp->data[len], &sdr_image[sdr_image_offset[record_id] + offset], size );
+    } else {
+        /* No room for the image, build this record alone (type 01h records are the largest) */
+        uint8_t record[sizeof(SDR_type_01h_t)];
 
-        /* Return not-const data from SDR */
-        if (index == 0) {
-            tmp_c = record_id;
-        } else if (index == 5) {
-            tmp_c = ipmb_addr;
-        } else if ( sdr_type == TYPE_01 || sdr_type == TYPE_02 ) {
-            if (index == 9) {
-                tmp_c = cur_sensor->entityinstance;
-            }
-            if (index == 7) {
-                tmp_c = record_id;
-            }
-        } else if ( sdr_type == TYPE_11 || sdr_type == TYPE_12 ) {
-            if (index == 13) {
-                tmp_c = cur_sensor->entityinstance;
-            }
-        }
-        rsp->data[len++] = tmp_c;
+        sdr_serialize_record( cur_sensor, record );
+        memcpy( &rsp->data[len], &record[offset], size );
     }
+    len += size;
 
     rsp->data_len = len;
 }
@@ -394,6 +697,8 @@ IPMI_HANDLER(ipmi_se_get_sdr, NETFN_SE, IPMI_GET_DEVICE_SDR_CMD, ipmi_msg *req,
 IPMI_HANDLER(ipmi_se_reserve_device_sdr, NETFN_SE, IPMI_RESERVE_DEVICE_SDR_REPOSITORY_CMD, ipmi_msg *req, ipmi_msg* rsp) {
     int len = rsp->data_len;
 
+    sdr_announced = true;
+
     reservationID++;
     if (reservationID == 0) {
         reservationID = 1;
@@ -411,7 +716,7 @@ IPMI_HANDLER(ipmi_se_get_sensor_reading, NETFN_SE, IPMI_GET_SENSOR_READING_CMD,
 
     sensor_t * cur_sensor = find_sensor_by_id( sensor_number );
 
-    if (sensor_number > sdr_count) {
+    if (cur_sensor == NULL) {
         rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
         rsp->data_len = 0;
         return;
@@ -438,19 +743,79 @@ IPMI_HANDLER(ipmi_se_get_sensor_reading, NETFN_SE, IPMI_GET_SENSOR_READING_CMD,
     rsp->completion_code = IPMI_CC_OK;
 }
 
+/* (sensor number, reading, state) tuples fitting in a response, after the next sensor number byte */
+#define SENSOR_READINGS_PER_RSP     ( ( IPMI_MAX_DATA_LEN - 1 ) / 3 )
+
+/*
+ * Bulk sensor reading, request: [0] first sensor number, [1] (optional) last sensor number
+ * Response: [0] next sensor number to ask for (0xFF once the range is done), then a (sensor number, reading, state)
+ * tuple per sensor. The state is the present threshold status with the scanning bits (Get Sensor Reading byte 2 [7:6])
+ * in [7:6], or for a hotswap sensor the current state mask, with a 0 reading. Device locator records are skipped.
+ * The tuples of a response are all taken at the same time.
+ */
+IPMI_HANDLER(ipmi_custom_cmd_get_sensor_readings, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_SENSOR_READINGS, ipmi_msg *req, ipmi_msg *rsp)
+{
+    uint8_t len = rsp->data_len = 0;
+    uint8_t count = 0;
+    uint8_t last;
+    uint8_t num;
+    sensor_t * sensor;
+
+    if (req->data_len < 1) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        return;
+    }
+
+    num = req->data[0];
+    last = (req->data_len > 1) ? req->data[1] : 0xFF;
+
+    if (num > last) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        return;
+    }
+
+    /* Filled once the range end is known */
+    len++;
+
+    /* Keep the sensor tasks from updating a reading while the response is built */
+    taskENTER_CRITICAL();
+    for ( ; ( num <= last ) && ( num < sdr_count ) && ( count < SENSOR_READINGS_PER_RSP ); num++ ) {
+        sensor = sdr_index[num];
+
+        if ( sensor->sdr_type == TYPE_01 ) {
+            rsp->data[len++] = num;
+            rsp->data[len++] = sensor->readout_value;
+            rsp->data[len++] = ( sensor->event_scan & 0xC0 ) | sensor->state;
+        } else if ( sensor->sdr_type == TYPE_02 ) {
+            rsp->data[len++] = num;
+            rsp->data[len++] = 0x00;
+            rsp->data[len++] = sensor->readout_value;
+        } else {
+            continue;
+        }
+        count++;
+    }
+    taskEXIT_CRITICAL();
+
+    rsp->data[0] = ( ( num > last ) || ( num >= sdr_count ) ) ? 0xFF : num;
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
+
 IPMI_HANDLER(ipmi_se_get_sensor_threshold, NETFN_SE, IPMI_GET_SENSOR_THRESHOLD_CMD,  ipmi_msg *req, ipmi_msg* rsp) {
     int sensor_number = req->data[0];
     int len = rsp->data_len;
 
+    sensor_t *cur_sensor = find_sensor_by_id( sensor_number );
+
     /* Check if the requested sensor exists */
-    if (sensor_number > sdr_count) {
+    if (cur_sensor == NULL) {
         rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
         rsp->data_len = 0;
         return;
     }
 
-    sensor_t *cur_sensor = find_sensor_by_id( sensor_number );
-
     /* Check if the selected sensor has a Full Sensor Record */
     if ( cur_sensor->sdr_type != TYPE_01) {
         rsp->completion_code = IPMI_CC_INV_DATA_FIELD_IN_REQ;
@@ -474,38 +839,58 @@ IPMI_HANDLER(ipmi_se_get_sensor_threshold, NETFN_SE, IPMI_GET_SENSOR_THRESHOLD_C
     rsp->completion_code = IPMI_CC_OK;
 }
 
-/* Sensor state checking function adapted from CERN MMCv2 implementation, credits in this file header */
-void sensor_state_check( sensor_t *sensor )
-{
-    if (sensor == NULL) return;
+/* Threshold event engine, the state and alarm checking are adapted from CERN MMCv2 implementation, credits in this file header */
 
-    SDR_type_01h_t * sdr = (SDR_type_01h_t *) sensor->sdr;
-    if(sdr == NULL || sdr->hdr.rectype != TYPE_01) return;
+/* Thresholds checked for each reading, in the order their events are sent */
+enum {
+    SENSOR_THR_UNC,
+    SENSOR_THR_UC,
+    SENSOR_THR_UNR,
+    SENSOR_THR_LNC,
+    SENSOR_THR_LC,
+    SENSOR_THR_LNR,
+};
 
-    /* Only check enabled sensors */
-    if (!(sensor->event_scan & 0xC0)) return;
+static const struct {
+    uint8_t sdr_field; /* Offset of the threshold in the type 01h record */
+    uint8_t offset; /* Event offset, also its bit in the event masks */
+    uint8_t upper; /* Asserted when the reading goes above the threshold, else when it goes below */
+} sensor_thr_table[SENSOR_THRESHOLD_COUNT] = {
+    [SENSOR_THR_UNC] = { offsetof( SDR_type_01h_t, upper_noncritical_thr ), IPMI_THRESHOLD_UNC_GH, 1 },
+    [SENSOR_THR_UC]  = { offsetof( SDR_type_01h_t, upper_critical_thr ),    IPMI_THRESHOLD_UC_GH,  1 },
+    [SENSOR_THR_UNR] = { offsetof( SDR_type_01h_t, upper_nonrecover_thr ),  IPMI_THRESHOLD_UNR_GH, 1 },
+    [SENSOR_THR_LNC] = { offsetof( SDR_type_01h_t, lower_noncritical_thr ), IPMI_THRESHOLD_LNC_GL, 0 },
+    [SENSOR_THR_LC]  = { offsetof( SDR_type_01h_t, lower_critical_thr ),    IPMI_THRESHOLD_LC_GL,  0 },
+    [SENSOR_THR_LNR] = { offsetof( SDR_type_01h_t, lower_nonrecover_thr ),  IPMI_THRESHOLD_LNR_GL, 0 },
+};
 
-    if(compare_val(sensor->readout_value, sdr->lower_noncritical_thr, UPPER_EQ, sensor->signed_flag) && compare_val(sensor->readout_value, sdr->upper_noncritical_thr, LOWER_EQ, sensor->signed_flag)) {
-        sensor->state = SENSOR_STATE_NORMAL;
-    } else if(compare_val(sensor->readout_value, sdr->upper_noncritical_thr, UPPER_EQ, sensor->signed_flag) && compare_val(sensor->readout_value, sdr->upper_critical_thr, LOWER_EQ, sensor->signed_flag)) {
-        sensor->state = SENSOR_STATE_HIGH;
-    } else if(compare_val(sensor->readout_value, sdr->upper_critical_thr, UPPER_EQ, sensor->signed_flag) && compare_val(sensor->readout_value, sdr->upper_nonrecover_thr, LOWER_EQ, sensor->signed_flag)) {
-        sensor->state = SENSOR_STATE_HIGH_CRIT;
-    } else if(compare_val(sensor->readout_value, sdr->upper_nonrecover_thr, UPPER_EQ, sensor->signed_flag)) {
-        sensor->state = SENSOR_STATE_HIGH_NON_REC;
-    } else if(compare_val(sensor->readout_value, sdr->lower_noncritical_thr, LOWER_EQ, sensor->signed_flag) && compare_val(sensor->readout_value, sdr->lower_critical_thr, UPPER_EQ, sensor->signed_flag)) {
-        sensor->state = SENSOR_STATE_LOW;
-    } else if(compare_val(sensor->readout_value, sdr->lower_critical_thr, LOWER_EQ, sensor->signed_flag) && compare_val(sensor->readout_value, sdr->lower_nonrecover_thr, UPPER_EQ, sensor->signed_flag)) {
-        sensor->state = SENSOR_STATE_LOW_CRIT;
-    } else if(compare_val(sensor->readout_value, sdr->lower_nonrecover_thr, LOWER_EQ, sensor->signed_flag)) {
-        sensor->state = SENSOR_STATE_LOW_NON_REC;
+/* Signed readings are compared with their sign bit flipped, which orders them as unsigned values */
+#define SENSOR_THR_BIAS(signed_flag)    ( ( (signed_flag) == SIGNED ) ? 0x80 : 0x00 )
+
+static void sensor_thr_update( sensor_t * sensor, SDR_type_01h_t * sdr )
+{
+    uint8_t bias = SENSOR_THR_BIAS( sensor->signed_flag );
+    uint8_t raw;
+    uint8_t i;
+
+    for ( i = 0; i < SENSOR_THRESHOLD_COUNT; i++ ) {
+        raw = ((uint8_t *) sdr)[sensor_thr_table[i].sdr_field];
+
+        sensor->thr.assert_at[i] = raw ^ bias;
+        /* The deassertion point is the threshold moved back by the hysteresis (computed on the raw value, as the reading is) */
+        if ( sensor_thr_table[i].upper ) {
+            sensor->thr.deassert_at[i] = (uint8_t) ( raw - sdr->neg_thr_hysteresis ) ^ bias;
+        } else {
+            sensor->thr.deassert_at[i] = (uint8_t) ( raw + sdr->pos_thr_hysteresis ) ^ bias;
+        }
     }
+
+    sensor->thr.signed_flag = sensor->signed_flag;
+    sensor->thr.valid = 1;
 }
 
-/* Sensor alarm checking function adapted from CERN MMCv2 implementation, credits in this file header */
-void check_sensor_event( sensor_t * sensor )
+void sensor_threshold_check( sensor_t * sensor )
 {
-    /** Should be rewritten to be compliant with RTM management !! */
     /* Event message: [0] - Event Data 1
                           [7:6] 00b = unspecified byte 2
                                 01b = trigger reading in byte 2
@@ -519,8 +904,17 @@ void check_sensor_event( sensor_t * sensor )
                       [1] - Event data 2 -> Reading that triggered the event
                       [2] - Event data 3 -> Threshold value that triggered the event
     */
-    uint8_t ev[3] = {0x0F, 0xFF, 0xFF};
-    uint8_t ev_type;
+    uint8_t ev[3];
+    uint8_t * t;
+    uint8_t * d;
+    uint8_t val;
+    uint8_t bias;
+    uint16_t reached = 0;
+    uint16_t cleared = 0;
+    uint16_t to_assert;
+    uint16_t to_deassert;
+    uint16_t bit;
+    uint8_t i;
 
     if (sensor == NULL) return;
 
@@ -531,148 +925,105 @@ void check_sensor_event( sensor_t * sensor )
     /* Only check enabled sensors */
     if (!(sensor->event_scan & 0xC0)) return;
 
-    /* The 0x50 OR'ed in ev[0] indicates that the sensor read value and threshold
-     * that triggered the event will be present in bytes 1 and 2, respectively */
-
-    /** Compare threshold with the upper thresholds */
-
-    /** Upper non-critical threshold going-high */
-    if(sdr->assertion_event_mask & (1 << IPMI_THRESHOLD_UNC_GH)) {
-        if(!sensor->asserted_event.upper_non_critical_go_high && compare_val(sensor->readout_value, sdr->upper_noncritical_thr, UPPER_EQ, sensor->signed_flag)){
-            ev_type = ASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_UNC_GH;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->upper_noncritical_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.upper_non_critical_go_high = 1;
-        }
+    if ( !sensor->thr.valid || ( sensor->thr.signed_flag != sensor->signed_flag ) ) {
+        sensor_thr_update( sensor, sdr );
     }
 
-    if(sdr->deassertion_event_mask & (1 << IPMI_THRESHOLD_UNC_GH)) {
-        if(sensor->asserted_event.upper_non_critical_go_high && compare_val(sensor->readout_value, (sdr->upper_noncritical_thr - sdr->neg_thr_hysteresis), LOWER_EQ, sensor->signed_flag)){
-            ev_type = DEASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_UNC_GH;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->upper_noncritical_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.upper_non_critical_go_high = 0;
-        }
-    }
+    bias = SENSOR_THR_BIAS( sensor->signed_flag );
+    val = (uint8_t) sensor->readout_value ^ bias;
+    t = sensor->thr.assert_at;
+    d = sensor->thr.deassert_at;
 
-    /** Upper critical threshold going-high */
-    if(sdr->assertion_event_mask & (1 << IPMI_THRESHOLD_UC_GH)) {
-        if(!sensor->asserted_event.upper_critical_go_high && compare_val(sensor->readout_value, sdr->upper_critical_thr, UPPER_EQ, sensor->signed_flag)){
-            ev_type = ASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_UC_GH;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->upper_critical_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.upper_critical_go_high = 1;
-        }
+    /** Present state */
+    if ( ( val >= t[SENSOR_THR_LNC] ) && ( val <= t[SENSOR_THR_UNC] ) ) {
+        sensor->state = SENSOR_STATE_NORMAL;
+    } else if ( ( val >= t[SENSOR_THR_UNC] ) && ( val <= t[SENSOR_THR_UC] ) ) {
+        sensor->state = SENSOR_STATE_HIGH;
+    } else if ( ( val >= t[SENSOR_THR_UC] ) && ( val <= t[SENSOR_THR_UNR] ) ) {
+        sensor->state = SENSOR_STATE_HIGH_CRIT;
+    } else if ( val >= t[SENSOR_THR_UNR] ) {
+        sensor->state = SENSOR_STATE_HIGH_NON_REC;
+    } else if ( ( val <= t[SENSOR_THR_LNC] ) && ( val >= t[SENSOR_THR_LC] ) ) {
+        sensor->state = SENSOR_STATE_LOW;
+    } else if ( ( val <= t[SENSOR_THR_LC] ) && ( val >= t[SENSOR_THR_LNR] ) ) {
+        sensor->state = SENSOR_STATE_LOW_CRIT;
+    } else if ( val <= t[SENSOR_THR_LNR] ) {
+        sensor->state = SENSOR_STATE_LOW_NON_REC;
     }
 
-    if(sdr->deassertion_event_mask & (1 << IPMI_THRESHOLD_UC_GH)) {
-        if(sensor->asserted_event.upper_critical_go_high && compare_val(sensor->readout_value, (sdr->upper_critical_thr - sdr->neg_thr_hysteresis), LOWER_EQ, sensor->signed_flag)){
-            ev_type = DEASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_UC_GH;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->upper_critical_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.upper_critical_go_high = 0;
-        }
-    }
+    /** Thresholds reached by the reading, and the ones it went back from (hysteresis included) */
+    for ( i = 0; i < SENSOR_THRESHOLD_COUNT; i++ ) {
+        bit = 1 << sensor_thr_table[i].offset;
 
-    /** Upper non-recoverable threshold going-high */
-    if(sdr->assertion_event_mask & (1 << IPMI_THRESHOLD_UNR_GH)) {
-        if(!sensor->asserted_event.upper_non_recoverable_go_high && compare_val(sensor->readout_value, sdr->upper_nonrecover_thr, UPPER_EQ, sensor->signed_flag)){
-            ev_type = ASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_UNR_GH;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->upper_nonrecover_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.upper_non_recoverable_go_high = 1;
+        if ( sensor_thr_table[i].upper ) {
+            reached |= ( val >= t[i] ) ? bit : 0;
+            cleared |= ( val <= d[i] ) ? bit : 0;
+        } else {
+            reached |= ( val <= t[i] ) ? bit : 0;
+            cleared |= ( val >= d[i] ) ? bit : 0;
         }
     }
 
-    if(sdr->deassertion_event_mask & (1 << IPMI_THRESHOLD_UNR_GH)) {
-        if(sensor->asserted_event.upper_non_recoverable_go_high && compare_val(sensor->readout_value, (sdr->upper_nonrecover_thr - sdr->neg_thr_hysteresis), LOWER_EQ, sensor->signed_flag)){
-            ev_type = DEASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_UNR_GH;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->upper_nonrecover_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.upper_non_recoverable_go_high = 0;
-        }
-    }
+    to_assert = reached & sdr->assertion_event_mask & ~sensor->asserted_events;
+    to_deassert = cleared & sdr->deassertion_event_mask & ( sensor->asserted_events | to_assert );
 
-    /** Lower non-critical threshold going-high */
-    if(sdr->assertion_event_mask & (1 << IPMI_THRESHOLD_LNC_GL)) {
-        if(!sensor->asserted_event.lower_non_critical_go_low && compare_val(sensor->readout_value, sdr->lower_noncritical_thr, LOWER_EQ, sensor->signed_flag)){
-            ev_type = ASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_LNC_GL;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->lower_noncritical_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.lower_non_critical_go_low = 1;
-        }
+    /* Nothing changed, which is the case of almost every reading */
+    if ( ( to_assert | to_deassert ) == 0 ) {
+        return;
     }
 
-    if(sdr->deassertion_event_mask & (1 << IPMI_THRESHOLD_LNC_GL)) {
-        if(sensor->asserted_event.lower_non_critical_go_low && compare_val(sensor->readout_value, (sdr->lower_noncritical_thr + sdr->pos_thr_hysteresis), UPPER_EQ, sensor->signed_flag)){
-            ev_type = DEASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_LNC_GL;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->lower_noncritical_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.lower_non_critical_go_low = 0;
+    sensor->asserted_events = ( sensor->asserted_events | to_assert ) & ~to_deassert;
+
+    /* The 0x50 OR'ed in ev[0] indicates that the sensor read value and threshold
+     * that triggered the event will be present in bytes 1 and 2, respectively */
+    for ( i = 0; i < SENSOR_THRESHOLD_COUNT; i++ ) {
+        bit = 1 << sensor_thr_table[i].offset;
+
+        ev[0] = 0x50 | sensor_thr_table[i].offset;
+        ev[1] = sensor->readout_value;
+        ev[2] = t[i] ^ bias;
+
+        if ( to_assert & bit ) {
+            ipmi_event_send(sensor, ASSERTION_EVENT, ev, sizeof(ev));
+        }
+        if ( to_deassert & bit ) {
+            ipmi_event_send(sensor, DEASSERTION_EVENT, ev, sizeof(ev));
         }
     }
+}
 
-    /** Lower critical threshold going-high */
-    if(sdr->assertion_event_mask & (1 << IPMI_THRESHOLD_LC_GL)) {
-        if(!sensor->asserted_event.lower_critical_go_low && compare_val(sensor->readout_value, sdr->lower_critical_thr, LOWER_EQ, sensor->signed_flag)){
-            ev_type = ASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_LC_GL;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->lower_critical_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.lower_critical_go_low = 1;
-        }
+uint8_t sensor_threshold_distance( sensor_t * sensor )
+{
+    SDR_type_01h_t * sdr = (SDR_type_01h_t *) sensor->sdr;
+    uint8_t dist = 0xFF;
+    uint8_t val;
+    uint8_t d;
+    uint8_t i;
+
+    if ( ( sensor->sdr_type != TYPE_01 ) || !sensor->thr.valid ) {
+        return dist;
     }
 
-    if(sdr->deassertion_event_mask & (1 << IPMI_THRESHOLD_LC_GL)) {
-        if(sensor->asserted_event.lower_critical_go_low && compare_val(sensor->readout_value, (sdr->lower_critical_thr + sdr->pos_thr_hysteresis), UPPER_EQ, sensor->signed_flag)){
-            ev_type = DEASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_LC_GL;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->lower_critical_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.lower_critical_go_low = 0;
+    val = (uint8_t) sensor->readout_value ^ SENSOR_THR_BIAS( sensor->thr.signed_flag );
+
+    /* Only the thresholds sending an event count, the others are often left at the end of the range */
+    for ( i = 0; i < SENSOR_THRESHOLD_COUNT; i++ ) {
+        if ( !( sdr->assertion_event_mask & ( 1 << sensor_thr_table[i].offset ) ) ) {
+            continue;
         }
-    }
 
-    /** Lower non-recoverable threshold going-high */
-    if(sdr->assertion_event_mask & (1 << IPMI_THRESHOLD_LNR_GL)) {
-        if(!sensor->asserted_event.lower_non_recoverable_go_high && compare_val(sensor->readout_value, sdr->lower_nonrecover_thr, LOWER_EQ, sensor->signed_flag)){
-            ev_type = ASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_LNR_GL;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->lower_nonrecover_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.lower_non_recoverable_go_high = 1;
+        if ( sensor_thr_table[i].upper ) {
+            d = ( val < sensor->thr.assert_at[i] ) ? ( sensor->thr.assert_at[i] - val ) : 0;
+        } else {
+            d = ( val > sensor->thr.assert_at[i] ) ? ( val - sensor->thr.assert_at[i] ) : 0;
         }
-    }
 
-    if(sdr->deassertion_event_mask & (1 << IPMI_THRESHOLD_LNR_GL)) {
-        if(sensor->asserted_event.lower_non_recoverable_go_high && compare_val(sensor->readout_value, (sdr->lower_nonrecover_thr + sdr->pos_thr_hysteresis), UPPER_EQ, sensor->signed_flag)){
-            ev_type = DEASSERTION_EVENT;
-            ev[0] = 0x50 | IPMI_THRESHOLD_LNR_GL;
-            ev[1] = sensor->readout_value;
-            ev[2] = sdr->lower_nonrecover_thr;
-            ipmi_event_send(sensor, ev_type, ev, sizeof(ev));
-            sensor->asserted_event.lower_non_recoverable_go_high = 0;
+        if ( d < dist ) {
+            dist = d;
         }
     }
+
+    return dist;
 }
 
 /* Management Controller Device Locator Record 37.9 SDR Type 12h */
@@ -37,6 +37,14 @@
 #define SENSOR_TYPE_VERSION_CHANGE      0x2B
 #define SENSOR_TYPE_HOT_SWAP            0xF2
 
+/* Entity IDs */
+#define SDR_ENTITY_RTM                  0xC0    // PICMG rear transition module
+#define SDR_ENTITY_AMC                  0xC1    // PICMG AMC module
+
+/* Sensor event_scan bits, as in Get Sensor Reading byte 2 */
+#define SENSOR_EVENTS_ENABLED           0x80
+#define SENSOR_SCAN_ENABLED             0x40
+
 /* Assertion Event Codes */
 #define ASSERTION_EVENT                 0x00
 #define DEASSERTION_EVENT               0x80
@@ -64,13 +72,10 @@
 #define IPMI_THRESHOLD_UNR_GL           0x0A    // upper non recoverable going low
 #define IPMI_THRESHOLD_UNR_GH           0x0B    // upper non recoverable going high
 
-/* Constants for comparison function */
+/* Reading format of a sensor (sensor_t::signed_flag) */
 #define UNSIGNED	0x00
 #define SIGNED		0x01
 
-#define LOWER_EQ	0x00
-#define UPPER_EQ	0x01
-
 
 typedef enum {
     TYPE_01 = 0x1,
@@ -178,6 +183,26 @@ typedef struct {
     char IDstring[16];
 } SDR_type_12h_t;
 
+/**
+ * @brief Maximum number of entries in the SDR repository (record IDs and sensor numbers are 8 bits wide)
+ */
+#define SDR_MAX_ENTRIES             255
+
+/**
+ * @brief Initial capacity of the SDR repository index, doubled each time it gets full
+ */
+#define SDR_INDEX_INITIAL_SIZE      16
+
+/**
+ * @brief Number of thresholds checked for events on a threshold based (type 01h) sensor
+ */
+#define SENSOR_THRESHOLD_COUNT      6
+
+/**
+ * @brief Maximum number of monitor tasks (sensor drivers) with sensors in the SDR repository
+ */
+#define SDR_MAX_MONITOR_TASKS       8
+
 typedef struct sensor_t {
     uint8_t num;
     SDR_TYPE sdr_type;
@@ -193,22 +218,20 @@ typedef struct sensor_t {
     uint8_t ownerID; /* This field is repeated here because its value is assigned during initialization, so it can't be const */
     uint8_t entityinstance; /* This field is repeated here because its value is assigned during initialization, so it can't be const */
     TaskHandle_t * task_handle;
+    uint16_t asserted_events; /* Asserted threshold events, bit n is the event offset n as in the SDR event masks */
     struct {
-        uint16_t upper_non_recoverable_go_high:1;
-        uint16_t upper_non_recoverable_go_low:1;
-        uint16_t upper_critical_go_high:1;
-        uint16_t upper_critical_go_low:1;
-        uint16_t upper_non_critical_go_high:1;
-        uint16_t upper_non_critical_go_low:1;
-        uint16_t lower_non_recoverable_go_high:1;
-        uint16_t lower_non_recoverable_go_low:1;
-        uint16_t lower_critical_go_high:1;
-        uint16_t lower_critical_go_low:1;
-        uint16_t lower_non_critical_go_high:1;
-        uint16_t lower_non_critical_go_low:1;
-    } asserted_event;
+        uint8_t valid;
+        uint8_t signed_flag;
+        uint8_t assert_at[SENSOR_THRESHOLD_COUNT];
+        uint8_t deassert_at[SENSOR_THRESHOLD_COUNT];
+    } thr; /* Thresholds and hysteresis points as compared by sensor_threshold_check(), computed from the SDR on first use */
     void* settings;
     struct sensor_t *next;
+    struct sensor_t *task_next; /* Next sensor updated by the same monitor task, see sdr_task_sensors() */
+    struct sensor_history *history; /* Past readings, only kept for the sensors polled by the sensor scheduler */
+    struct sensor_filter *filter; /* Reading filter, see sensor_filter_set() */
+    const struct sensor_sched_rate *rate; /* Polling period bounds, see sensor_sched_set_rate() */
+    struct sensor_sched_state *sched; /* Polling schedule, set up by the sensor scheduler when it first reads the sensor */
 } sensor_t;
 
 extern volatile uint8_t sdr_count;
@@ -230,13 +253,89 @@ void rtm_sdr_init( void );
 void sensor_init( void );
 void sensor_enable(sensor_t *sensor);
 void sensor_disable(sensor_t *sensor);
-void check_sensor_event( sensor_t * sensor );
-void sensor_state_check( sensor_t *sensor );
+
+/**
+ * @brief Enables the threshold sensors of an entity, e.g. once its board has been plugged in
+ *
+ * The sensors start over from no asserted event, and are read again within one reading period.
+ *
+ * @param entity_id Entity ID of the sensors in their SDR (#SDR_ENTITY_RTM...)
+ */
+void sdr_activate_sensors( uint8_t entity_id );
+
+/**
+ * @brief Disables the threshold sensors of an entity, e.g. when its board is removed
+ *
+ * Their scanning is disabled (see Get Sensor Reading), and the sensor scheduler stops reading them. The hotswap and
+ * device locator records of the entity stay as they are, since they tell the MCH about its presence.
+ *
+ * @param entity_id Entity ID of the sensors in their SDR (#SDR_ENTITY_RTM...)
+ */
+void sdr_disable_sensors( uint8_t entity_id );
+
+/**
+ * @brief Updates the threshold state of a sensor from its last reading and sends the threshold events
+ *
+ * The present state (#SENSOR_STATE_NORMAL...) and the asserted events are updated in a single pass over the six
+ * thresholds. Assertions follow the SDR assertion mask and deassertions the deassertion mask, after the reading has gone
+ * back past the threshold hysteresis.
+ *
+ * @param sensor Threshold based (type 01h) sensor, others are ignored
+ */
+void sensor_threshold_check( sensor_t * sensor );
+
+/**
+ * @brief Distance between the last reading of a sensor and its nearest threshold
+ *
+ * Only the thresholds with their assertion event enabled are taken into account.
+ *
+ * @param sensor Threshold based (type 01h) sensor, already checked once by #sensor_threshold_check
+ *
+ * @return Distance in raw counts, 0 if a threshold is reached, 0xFF if there's no threshold to reach
+ */
+uint8_t sensor_threshold_distance( sensor_t * sensor );
+
 sensor_t * sdr_insert_entry( SDR_TYPE type, void * sdr, TaskHandle_t *monitor_task, uint8_t diag_id, uint8_t slave_addr);
-void sdr_remove_entry( sensor_t * entry );
+/**
+ * @brief Removes a sensor from the repository, renumbering the following ones
+ *
+ * Only allowed until the MCH first reads the repository (Get Device SDR Info, Reserve Device SDR Repository or Get Device SDR),
+ * as it then keeps the sensor numbers.
+ *
+ * @param entry Sensor to remove
+ *
+ * @retval true Sensor removed and freed
+ * @retval false Unknown sensor, or the repository was already read by the MCH
+ */
+bool sdr_remove_entry( sensor_t * entry );
 void sdr_pop( void );
 sensor_t * sdr_add_settings(uint8_t chipid, void * settings);
 sensor_t * find_sensor_by_sdr( void * sdr );
 sensor_t * find_sensor_by_id( uint8_t id );
 
+/**
+ * @brief Gets the sensors updated by a monitor task
+ *
+ * Each monitor task has its own list, filled by #sdr_insert_entry in the repository order, so a driver only goes through its
+ * own sensors instead of the whole repository.
+ *
+ * @param monitor_task Handle given to #sdr_insert_entry when the sensors were added
+ *
+ * @return First sensor of the task, the others are linked through sensor_t::task_next, or NULL if it has none
+ */
+sensor_t * sdr_task_sensors( TaskHandle_t * monitor_task );
+
+/**
+ * @brief Keeps the sensors of the monitor task lists from being removed
+ *
+ * To be held while walking #sdr_task_sensors from a task other than the one removing the sensors. Sensors can still be
+ * inserted meanwhile, they are appended to the lists once fully set up.
+ */
+void sdr_task_lists_take( void );
+
+/**
+ * @brief Releases the monitor task lists taken by #sdr_task_lists_take
+ */
+void sdr_task_lists_give( void );
+
 #endif
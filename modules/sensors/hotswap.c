@@ -79,17 +79,8 @@ void hotswap_init( void )
     SDR_type_02h_t * hotswap_pSDR;
     sensor_t * hotswap_sensor;
 
-    /* Iterate through the SDR Table to find all the Hotswap entries */
-    for ( hotswap_sensor = sdr_head; hotswap_sensor != NULL; hotswap_sensor = hotswap_sensor->next) {
-
-        if ( hotswap_sensor->task_handle == NULL ) {
-            continue;
-        }
-
-        /* Check if this task should update the selected SDR */
-        if ( *(hotswap_sensor->task_handle) != vTaskHotSwap_Handle ) {
-            continue;
-        }
+    /* Go through the Hotswap entries only, the SDR module keeps them listed by monitor task */
+    for ( hotswap_sensor = sdr_task_sensors( &vTaskHotSwap_Handle ); hotswap_sensor != NULL; hotswap_sensor = hotswap_sensor->task_next ) {
 
         hotswap_pSDR = (SDR_type_02h_t *) hotswap_sensor->sdr;
 
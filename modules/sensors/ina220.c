@@ -35,10 +35,10 @@
 /* Project Includes */
 #include "port.h"
 #include "sdr.h"
-#include "task_priorities.h"
 #include "i2c.h"
 #include "i2c_mapping.h"
 #include "ina220.h"
+#include "sensor_sched.h"
 #include "fpga_spi.h"
 #include "fru.h"
 
@@ -61,53 +61,6 @@ const ina220_config_t ina220_cfg = {
 
 static ina220_data_t ina220_data[MAX_INA220_COUNT];
 
-void vTaskINA220( void *Parameters )
-{
-    uint8_t i;
-    TickType_t xLastWakeTime;
-    /* Task will run every 100ms */
-    const TickType_t xFrequency = INA220_UPDATE_RATE / portTICK_PERIOD_MS;
-
-    sensor_t * ina220_sensor;
-    ina220_data_t * data_ptr;
-
-    /* Initialise the xLastWakeTime variable with the current time. */
-    xLastWakeTime = xTaskGetTickCount();
-
-    for (;;) {
-        /* Read all registers from the INA220s */
-        for ( i = 0; i < MAX_INA220_COUNT; i++) {
-            ina220_readall( &ina220_data[i] );
-
-            ina220_sensor = ina220_data[i].sensor;
-            data_ptr = &ina220_data[i];
-
-            if (ina220_sensor == NULL) {
-                continue;
-            }
-
-            switch ((GET_SENSOR_TYPE(ina220_sensor))) {
-            case SENSOR_TYPE_VOLTAGE:
-                ina220_sensor->readout_value = (data_ptr->regs[INA220_BUS_VOLTAGE] >> data_ptr->config->bus_voltage_shift)/16;
-                break;
-            case SENSOR_TYPE_CURRENT:
-                /* Current in mA */
-                ina220_sensor->readout_value = data_ptr->regs[INA220_CURRENT]/32;
-                break;
-            default:
-                /* Shunt voltage and power not implemented */
-                break;
-            }
-
-            /* Check for threshold events */
-            sensor_state_check(ina220_sensor);
-            check_sensor_event(ina220_sensor);
-
-        }
-        vTaskDelayUntil( &xLastWakeTime, xFrequency );
-    }
-}
-
 uint8_t ina220_config( ina220_data_t * data )
 {
     uint8_t i2c_interf, i2c_addr;
@@ -151,14 +104,6 @@ Bool ina220_readvalue( ina220_data_t * data, uint8_t reg, uint16_t *read )
     return false;
 }
 
-void ina220_readall( ina220_data_t * data )
-{
-    /* Read all INA220 Registers */
-    for ( uint8_t i = 0; i < INA220_REGISTERS; i++ ) {
-        ina220_readvalue( data, i, &(data->regs[i]) );
-    }
-}
-
 Bool ina220_calibrate( ina220_data_t * data )
 {
     uint8_t i2c_interf, i2c_addr;
@@ -176,24 +121,65 @@ Bool ina220_calibrate( ina220_data_t * data )
     return false;
 }
 
-void ina220_init( void )
+static mmc_err ina220_read( sensor_t * sensor )
 {
-    sensor_t *temp_sensor;
-    uint8_t i = 0;
+    ina220_data_t * data_ptr = NULL;
+    uint8_t reg;
+    uint8_t i;
 
-    xTaskCreate( vTaskINA220, "INA220", 200, (void *) NULL, tskINA220SENSOR_PRIORITY, &vTaskINA220_Handle);
+    for ( i = 0; i < MAX_INA220_COUNT; i++ ) {
+        if ( ina220_data[i].sensor == sensor ) {
+            data_ptr = &ina220_data[i];
+            break;
+        }
+    }
 
-    /* Iterate through the SDR Table to find all the INA220 entries */
-    for ( temp_sensor = sdr_head; temp_sensor != NULL; temp_sensor = temp_sensor->next) {
+    if ( data_ptr == NULL ) {
+        return MMC_INVALID_ARG_ERR;
+    }
 
-        if ( temp_sensor->task_handle == NULL ) {
-            continue;
-        }
+    /* Only the register giving this sensor's value is read */
+    switch ((GET_SENSOR_TYPE(sensor))) {
+    case SENSOR_TYPE_VOLTAGE:
+        reg = INA220_BUS_VOLTAGE;
+        break;
+    case SENSOR_TYPE_CURRENT:
+        reg = INA220_CURRENT;
+        break;
+    default:
+        /* Shunt voltage and power not implemented */
+        return MMC_OK;
+    }
 
-        /* Check if this task should update the selected SDR */
-        if ( *(temp_sensor->task_handle) != vTaskINA220_Handle ) {
-            continue;
-        }
+    if ( !ina220_readvalue( data_ptr, reg, &(data_ptr->regs[reg]) ) ) {
+        return MMC_IO_ERR;
+    }
+
+    if ( reg == INA220_BUS_VOLTAGE ) {
+        sensor->readout_value = (data_ptr->regs[INA220_BUS_VOLTAGE] >> data_ptr->config->bus_voltage_shift)/16;
+    } else {
+        /* Current in mA */
+        sensor->readout_value = data_ptr->regs[INA220_CURRENT]/32;
+    }
+
+    return MMC_OK;
+}
+
+static const sensor_driver_t ina220_driver = {
+    .name = "INA220",
+    .monitor_task = &vTaskINA220_Handle,
+    .period = INA220_UPDATE_RATE,
+    .idle_period = INA220_IDLE_RATE,
+    .read = ina220_read,
+};
+
+void ina220_init( void )
+{
+    sensor_t *temp_sensor;
+    uint8_t i = 0;
+
+    /* Go through the INA220 entries only, the SDR module keeps them listed by monitor task */
+    for ( temp_sensor = sdr_task_sensors( &vTaskINA220_Handle ); temp_sensor != NULL; temp_sensor = temp_sensor->task_next ) {
 
         if (i < MAX_INA220_COUNT ) {
             ina220_data[i].sensor = temp_sensor;
@@ -207,4 +193,6 @@ void ina220_init( void )
             i++;
         }
     }
+
+    sensor_sched_register( &ina220_driver );
 }
@@ -45,6 +45,7 @@
 
 #define MAX_INA220_COUNT        12
 #define INA220_UPDATE_RATE      100
+#define INA220_IDLE_RATE        500
 
 /**
  * @defgroup INA220_REGS INA220 Registers
@@ -200,8 +201,6 @@ extern TaskHandle_t vTaskINA220_Handle;
 uint8_t ina220_config( ina220_data_t * data );
 Bool ina220_calibrate( ina220_data_t * data );
 Bool ina220_readvalue( ina220_data_t * data, uint8_t reg, uint16_t *read );
-void ina220_readall( ina220_data_t * data );
 void ina220_init( void );
-void vTaskINA220( void* Parameters );
 
 #endif
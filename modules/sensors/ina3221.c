@@ -34,77 +34,17 @@
 /* Project Includes */
 #include "port.h"
 #include "sdr.h"
-#include "task_priorities.h"
 #include "i2c.h"
 #include "i2c_mapping.h"
 #include "fpga_spi.h"
 #include "fru.h"
 #include "ina3221.h"
+#include "sensor_sched.h"
 
 TaskHandle_t vTaskINA3221_Handle;
 
 static ina3221_data_t ina3221_data[MAX_INA3221_COUNT];
 
-void vTaskINA3221( void *Parameters )
-{
-    uint8_t chip_num;
-    uint8_t channel;
-    TickType_t xLastWakeTime;
-    /* Task will run every 100ms */
-    const TickType_t xFrequency = pdMS_TO_TICKS(INA3221_UPDATE_RATE);
-
-    sensor_t * ina3221_sensor;
-    ina3221_data_t * data_ptr;
-    SDR_type_01h_t * sdr;
-
-    /* Initialise the xLastWakeTime variable with the current time. */
-    xLastWakeTime = xTaskGetTickCount();
-
-    for (;;) {
-        /* Read all registers from the INA3221s */
-        for ( chip_num = 0; chip_num < MAX_INA3221_COUNT; chip_num++) {
-
-            if (!(ina3221_data[chip_num].chipid)){
-                break;
-            }
-
-            if (!(ina3221_read_voltages( &ina3221_data[chip_num] ))) {
-            	break;
-            }
-
-            for ( uint8_t i = 0; i < 6; i++ ) {
-
-                ina3221_sensor = ina3221_data[chip_num].sensors[i];
-                data_ptr = &ina3221_data[chip_num];
-
-                if (ina3221_sensor == NULL) {
-                    continue;
-                }
-
-                sdr = (SDR_type_01h_t*)ina3221_sensor->sdr;
-                channel = sdr->OEM;
-
-                switch ((GET_SENSOR_TYPE(ina3221_sensor))) {
-                case SENSOR_TYPE_VOLTAGE:
-                    ina3221_sensor->readout_value = data_ptr->regs[2 * channel + 1] >> 6;
-                    break;
-                case SENSOR_TYPE_CURRENT:
-                    ina3221_sensor->readout_value = (((data_ptr->regs[2 * channel] >> 3) * 40) / ina3221_data[chip_num].config->shunt_resistor[channel]) >> 5;
-                    break;
-                default:
-                    break;
-                }
-
-                /* Check for threshold events */
-                sensor_state_check(ina3221_sensor);
-                check_sensor_event(ina3221_sensor);
-            }
-
-        }
-        vTaskDelayUntil( &xLastWakeTime, xFrequency );
-    }
-}
-
 uint8_t ina3221_read_reg( ina3221_data_t * data, uint8_t reg, uint16_t *read )
 {
     uint8_t i2c_interf, i2c_addr;
@@ -123,16 +63,56 @@ uint8_t ina3221_read_reg( ina3221_data_t * data, uint8_t reg, uint16_t *read )
     return rx_len;
 }
 
-uint8_t ina3221_read_voltages( ina3221_data_t * data )
+static mmc_err ina3221_read( sensor_t * sensor )
 {
-	uint8_t ret = 0xFF;
-    /* Read INA3221 Bus Voltage and Shunt Voltage Registers */
-    for ( uint8_t i = 0; i < INA3221_VOLTAGE_REGISTERS; i++ ) {
-        ret &= ina3221_read_reg(data, i + 1, &(data->regs[i]) );
+    ina3221_data_t * data_ptr = NULL;
+    uint8_t channel = ((SDR_type_01h_t *) sensor->sdr)->OEM;
+    uint8_t chip_num;
+    uint8_t idx;
+
+    for ( chip_num = 0; chip_num < MAX_INA3221_COUNT; chip_num++ ) {
+        if ( ina3221_data[chip_num].chipid == sensor->chipid ) {
+            data_ptr = &ina3221_data[chip_num];
+            break;
+        }
+    }
+
+    if ( data_ptr == NULL ) {
+        return MMC_INVALID_ARG_ERR;
+    }
+
+    /* regs[] holds the shunt and bus voltages of each channel, from register 1 on. Only this sensor's one is read */
+    switch ((GET_SENSOR_TYPE(sensor))) {
+    case SENSOR_TYPE_VOLTAGE:
+        idx = 2 * channel + 1;
+        break;
+    case SENSOR_TYPE_CURRENT:
+        idx = 2 * channel;
+        break;
+    default:
+        return MMC_OK;
     }
-    return ret;
+
+    if ( !ina3221_read_reg( data_ptr, idx + 1, &(data_ptr->regs[idx]) ) ) {
+        return MMC_IO_ERR;
+    }
+
+    if ( (GET_SENSOR_TYPE(sensor)) == SENSOR_TYPE_VOLTAGE ) {
+        sensor->readout_value = data_ptr->regs[idx] >> 6;
+    } else {
+        sensor->readout_value = (((data_ptr->regs[idx] >> 3) * 40) / data_ptr->config->shunt_resistor[channel]) >> 5;
+    }
+
+    return MMC_OK;
 }
 
+static const sensor_driver_t ina3221_driver = {
+    .name = "INA3221",
+    .monitor_task = &vTaskINA3221_Handle,
+    .period = INA3221_UPDATE_RATE,
+    .idle_period = INA3221_IDLE_RATE,
+    .read = ina3221_read,
+};
 
 void ina3221_init( void )
 {
@@ -143,19 +123,8 @@ void ina3221_init( void )
     uint8_t sens_num;
     uint8_t signed_flag;
 
-    xTaskCreate( vTaskINA3221, "INA3221", 200, (void *) NULL, tskINA3221SENSOR_PRIORITY, &vTaskINA3221_Handle);
-
-    /* Iterate through the SDR Table to find all the INA3221 entries */
-    for ( tmp_sensor = sdr_head; tmp_sensor != NULL; tmp_sensor = tmp_sensor->next) {
-
-        if ( tmp_sensor->task_handle == NULL ) {
-            continue;
-        }
-
-        /* Check if this task should update the selected SDR */
-        if ( *(tmp_sensor->task_handle) != vTaskINA3221_Handle ) {
-            continue;
-        }
+    /* Go through the INA3221 entries only, the SDR module keeps them listed by monitor task */
+    for ( tmp_sensor = sdr_task_sensors( &vTaskINA3221_Handle ); tmp_sensor != NULL; tmp_sensor = tmp_sensor->task_next ) {
 
         sdr = (SDR_type_01h_t*)tmp_sensor->sdr;
         ina_channel_num = sdr->OEM;
@@ -184,4 +153,6 @@ void ina3221_init( void )
             }
         }
     }
+
+    sensor_sched_register( &ina3221_driver );
 }
@@ -43,6 +43,7 @@
 
 #define MAX_INA3221_COUNT        6
 #define INA3221_UPDATE_RATE      100
+#define INA3221_IDLE_RATE        500
 
 #define INA3221_CHANNEL_1        0
 #define INA3221_CHANNEL_2        1
@@ -126,8 +127,6 @@ typedef struct {
 extern TaskHandle_t vTaskINA3221_Handle;
 
 uint8_t ina3221_read_reg( ina3221_data_t * data, uint8_t reg, uint16_t *read );
-uint8_t ina3221_read_voltages( ina3221_data_t * data );
 void ina3221_init( void );
-void vTaskINA3221( void* Parameters );
 
 #endif
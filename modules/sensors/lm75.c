@@ -35,58 +35,50 @@
 
 /* Project Includes */
 #include "sdr.h"
-#include "task_priorities.h"
 #include "i2c.h"
 #include "i2c_mapping.h"
 #include "lm75.h"
+#include "sensor_sched.h"
 #include "utils.h"
 #include "uart_debug.h"
 
 TaskHandle_t vTaskLM75_Handle;
 
-void vTaskLM75( void* Parameters )
-{
-    const TickType_t xFrequency = pdMS_TO_TICKS(LM75_UPDATE_RATE);
+/* Given by the I2C bus task once a reading is over */
+static SemaphoreHandle_t lm75_done;
 
-    uint8_t i2c_addr, i2c_interf;
-    sensor_t * temp_sensor;
+static mmc_err lm75_read( sensor_t * sensor )
+{
     uint8_t temp[2];
-    uint16_t converted_temp;
-
-    for ( ;; ) {
-        /* Iterate through the SDR Table to find all the LM75 entries */
-
-        for ( temp_sensor = sdr_head; temp_sensor != NULL; temp_sensor = temp_sensor->next) {
+    i2c_transaction_t xfer = {
+        .chip_id = sensor->chipid,
+        .rx_buff = temp,
+        .rx_len = sizeof(temp),
+        .done = lm75_done,
+    };
 
-            if ( temp_sensor->task_handle == NULL ) {
-                continue;
-            }
-
-            /* Check if this task should update the selected SDR */
-            if ( *(temp_sensor->task_handle) != xTaskGetCurrentTaskHandle() ) {
-                continue;
-            }
+    /* Update the temperature reading */
+    if ( ( i2c_transact( &xfer ) != MMC_OK ) || ( xfer.rx_count != sizeof(temp) ) ) {
+        return MMC_IO_ERR;
+    }
 
-            /* Try to gain the I2C bus */
-            if ( i2c_take_by_chipid( temp_sensor->chipid, &i2c_addr, &i2c_interf, portMAX_DELAY ) == pdTRUE ) {
+    sensor->readout_value = ((temp[0] << 1) | ((temp[1]>>7)));
 
-                /* Update the temperature reading */
-                if (xI2CMasterRead( i2c_interf, i2c_addr, &temp[0], 2) == 2) {
-                    converted_temp = ((temp[0] << 1) | ((temp[1]>>7)));
-                    temp_sensor->readout_value = converted_temp;
-                }
-                /* Check for threshold events */
-                i2c_give(i2c_interf);
-                sensor_state_check(temp_sensor);
-                check_sensor_event(temp_sensor);
-            }
-        }
-        vTaskDelay(xFrequency);
-    }
+    return MMC_OK;
 }
 
+static const sensor_driver_t lm75_driver = {
+    .name = "LM75",
+    .monitor_task = &vTaskLM75_Handle,
+    .period = LM75_UPDATE_RATE,
+    .idle_period = LM75_IDLE_RATE,
+    .read = lm75_read,
+};
 
 void LM75_init( void )
 {
-    xTaskCreate( vTaskLM75, "LM75", 200, (void *) NULL, tskLM75SENSOR_PRIORITY, &vTaskLM75_Handle);
+    lm75_done = xSemaphoreCreateBinary();
+    configASSERT( lm75_done );
+
+    sensor_sched_register( &lm75_driver );
 }
@@ -46,6 +46,14 @@
  */
 #define LM75_UPDATE_RATE        500
 
+/**
+ * @brief Rate at which the LM75 sensors far from their thresholds are read (in ms)
+ */
+#define LM75_IDLE_RATE          2000
+
+/**
+ * @brief LM75 sensors list key for #sdr_insert_entry and #sdr_task_sensors (it holds no task, the sensors are read by #vTaskSensorSched)
+ */
 extern TaskHandle_t vTaskLM75_Handle;
 
 extern const SDR_type_01h_t SDR_LM75_uC;
@@ -54,19 +62,13 @@ extern const SDR_type_01h_t SDR_LM75_DCDC;
 extern const SDR_type_01h_t SDR_LM75_RAM;
 
 /**
- * @brief Initializes LM75 monitoring task
+ * @brief Registers the LM75 driver in the sensor scheduler
+ *
+ * Each LM75 sensor listed in this module's SDR table is then read every #LM75_UPDATE_RATE ms near its thresholds,
+ * and down to every #LM75_IDLE_RATE ms away from them
  *
  * @return None
  */
 void LM75_init( void );
 
-/**
- * @brief Monitoring task for LM75 sensor
- *
- * This task unblocks after every #LM75_UPDATE_RATE ms and updates the read from all the LM75 sensors listed in this module's SDR table
- *
- * @param Parameters Pointer to parameter list passed to task upon initialization (not used here)
- */
-void vTaskLM75( void* Parameters );
-
 #endif
@@ -5,17 +5,17 @@
 
 /* Project Includes */
 #include "sdr.h"
-#include "task_priorities.h"
 #include "i2c.h"
 #include "i2c_mapping.h"
 #include "max11609.h"
 #include "utils.h"
 #include "uart_debug.h"
 #include "max116xx.h"
+#include "sensor_sched.h"
 
 TaskHandle_t vTask11609_Handle;
 
-void vTaskMAX11609( void* Parameters )
+static mmc_err max11609_read( sensor_t * sensor )
 {
     max116xx_cfg max11609_cfg = {
         .ref_sel   = MAX116XX_REF_INT_ON_OUT,
@@ -23,43 +23,29 @@ void vTaskMAX11609( void* Parameters )
         .pol_sel   = MAX116XX_UNIPOLAR,
         .scan_mode = MAX116XX_SCAN_OFF_SINGLE_CONV,
         .diff_mode = MAX116XX_SINGLE_ENDED,
-        .channel_sel = 0
+        .channel_sel = ((SDR_type_01h_t*)sensor->sdr)->OEM
     };
-    const TickType_t update_period = pdMS_TO_TICKS(MAX11609_UPDATE_PERIOD);
-
-    sensor_t * voltage_sensor;
     int16_t data_voltage[1];
     mmc_err err;
 
-    for ( ;; ) {
-        /* Iterate through the SDR Table to find all the MAX11609 entries */
-        for ( voltage_sensor = sdr_head; voltage_sensor != NULL; voltage_sensor = voltage_sensor->next) {
-            if ( voltage_sensor->task_handle == NULL ) {
-                continue;
-            }
-            /* Check if this task should update the selected SDR */
-            if ( *(voltage_sensor->task_handle) != xTaskGetCurrentTaskHandle() ) {
-                continue;
-            }
-
-            max11609_cfg.channel_sel = ((SDR_type_01h_t*)voltage_sensor->sdr)->OEM;
-            err = max116xx_set_config(voltage_sensor->chipid, &max11609_cfg);
-            if(err != MMC_OK) continue;
-
-            err = max116xx_read_uni(voltage_sensor->chipid, data_voltage, 1);
-            if (err == MMC_OK)
-            {
-                voltage_sensor->readout_value = (uint16_t)(data_voltage[0] >> 2);
-            }
-
-            sensor_state_check(voltage_sensor);
-            check_sensor_event(voltage_sensor);
-        }
-        vTaskDelay(update_period);
+    err = max116xx_config_read(sensor->chipid, &max11609_cfg, data_voltage, 1);
+    if (err == MMC_OK)
+    {
+        sensor->readout_value = (uint16_t)(data_voltage[0] >> 2);
     }
+
+    return err;
 }
 
-void MAX11609_init()
+static const sensor_driver_t max11609_driver = {
+    .name = "MAX11609",
+    .monitor_task = &vTask11609_Handle,
+    .period = MAX11609_UPDATE_PERIOD,
+    .idle_period = MAX11609_IDLE_PERIOD,
+    .read = max11609_read,
+};
+
+void MAX11609_init( void )
 {
-    xTaskCreate(vTaskMAX11609, "MAX11609", 256, (void *) NULL, tskMAX11609SENSOR_PRIORITY, &vTask11609_Handle);
+    sensor_sched_register( &max11609_driver );
 }
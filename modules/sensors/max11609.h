@@ -6,6 +6,11 @@
  */
 #define MAX11609_UPDATE_PERIOD    200
 
+/**
+ * @brief Rate at which the MAX11609 sensors far from their thresholds are read (in ms)
+ */
+#define MAX11609_IDLE_PERIOD      1000
+
 #define MAX11609_CHANNEL_0        0
 #define MAX11609_CHANNEL_1        1
 #define MAX11609_CHANNEL_2        2
@@ -15,19 +20,19 @@
 #define MAX11609_CHANNEL_6        6
 #define MAX11609_CHANNEL_7        7
 
+/**
+ * @brief MAX11609 sensors list key for #sdr_insert_entry and #sdr_task_sensors (it holds no task, the sensors are read by #vTaskSensorSched)
+ */
 extern TaskHandle_t vTask11609_Handle;
 
 extern const SDR_type_01h_t SDR_MAX11609_12V_HP;
 
-void MAX11609_init( void );
-
 /**
- * @brief Monitoring task for MAX11609 sensor
+ * @brief Registers the MAX11609 driver in the sensor scheduler
  *
- * This task unblocks after every #MAX11609_UPDATE_PERIOD ms and updates the read from all the MAX11609 sensors listed in this module's SDR table
- *
- * @param Parameters Pointer to parameter list passed to task upon initialization (not used here)
+ * Each MAX11609 sensor listed in this module's SDR table is then read every #MAX11609_UPDATE_PERIOD ms near its
+ * thresholds, and down to every #MAX11609_IDLE_PERIOD ms away from them
  */
-void vTaskMAX11609( void* Parameters );
+void MAX11609_init( void );
 
 #endif
@@ -34,49 +34,55 @@
 
 /* Project Includes */
 #include "sdr.h"
-#include "task_priorities.h"
 #include "i2c.h"
 #include "i2c_mapping.h"
 #include "max6642.h"
+#include "sensor_sched.h"
 #include "utils.h"
 #include "uart_debug.h"
 
 TaskHandle_t vTaskMAX6642_Handle;
 
-void vTaskMAX6642( void* Parameters )
-{
-    const TickType_t xFrequency = pdMS_TO_TICKS(MAX6642_UPDATE_RATE);
-
-    sensor_t * temp_sensor;
-
-    for ( ;; ) {
-        /* Iterate through the SDR Table to find all the LM75 entries */
+/* Given by the I2C bus task once a reading is over */
+static SemaphoreHandle_t max6642_done;
 
-        for ( temp_sensor = sdr_head; temp_sensor != NULL; temp_sensor = temp_sensor->next ) {
-
-            if ( temp_sensor->task_handle == NULL ) {
-                continue;
-            }
-
-            /* Check if this task should update the selected SDR */
-            if ( *(temp_sensor->task_handle) != xTaskGetCurrentTaskHandle() ) {
-                continue;
-            }
+static mmc_err max6642_read( sensor_t * sensor )
+{
+    const uint8_t cmd = MAX6642_CMD_READ_REMOTE;
+    uint8_t temp;
+    i2c_transaction_t xfer = {
+        .chip_id = sensor->chipid,
+        .tx_buff = &cmd,
+        .tx_len = 1,
+        .rx_buff = &temp,
+        .rx_len = 1,
+        .done = max6642_done,
+    };
+
+    /* Update the temperature reading */
+    if ( ( i2c_transact( &xfer ) != MMC_OK ) || ( xfer.rx_count != 1 ) ) {
+        return MMC_IO_ERR;
+    }
 
-            /* Update the temperature reading */
-            max6642_read_remote( temp_sensor, (uint8_t *) &(temp_sensor->readout_value) );
+    sensor->readout_value = temp;
 
-            /* Check for threshold events */
-            sensor_state_check(temp_sensor);
-            check_sensor_event(temp_sensor);
-        }
-        vTaskDelay(xFrequency);
-    }
+    return MMC_OK;
 }
 
+static const sensor_driver_t max6642_driver = {
+    .name = "MAX6642",
+    .monitor_task = &vTaskMAX6642_Handle,
+    .period = MAX6642_UPDATE_RATE,
+    .idle_period = MAX6642_IDLE_RATE,
+    .read = max6642_read,
+};
+
 void MAX6642_init( void )
 {
-    xTaskCreate( vTaskMAX6642, "MAX6642", 200, (void *) NULL, tskMAX6642SENSOR_PRIORITY, &vTaskMAX6642_Handle );
+    max6642_done = xSemaphoreCreateBinary();
+    configASSERT( max6642_done );
+
+    sensor_sched_register( &max6642_driver );
 }
 
 Bool max6642_read_local( sensor_t *sensor, uint8_t *temp )
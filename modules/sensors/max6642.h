@@ -36,6 +36,7 @@
 #define MAX6642_H_
 
 #define MAX6642_UPDATE_RATE             500
+#define MAX6642_IDLE_RATE               2000
 
 #define MAX6642_CMD_READ_LOCAL          0x00
 #define MAX6642_CMD_READ_REMOTE         0x01
@@ -64,26 +65,22 @@
 #define MAX6642_STATUS_OPEN_MASK        (1 << 4)
 
 /**
- * @brief MAX6642 monitor Task Handle
+ * @brief MAX6642 sensors list key for #sdr_insert_entry and #sdr_task_sensors (it holds no task, the sensors are read by #vTaskSensorSched)
  */
 extern TaskHandle_t vTaskMAX6642_Handle;
 
 extern const SDR_type_01h_t SDR_MAX6642_FPGA;
 
 /**
- * @brief Initializes MAX6642 sensor and creates #vTaskMAX6642
+ * @brief Registers the MAX6642 driver in the sensor scheduler
+ *
+ * Each MAX6642 sensor is then read every #MAX6642_UPDATE_RATE ms near its thresholds, and down to every
+ * #MAX6642_IDLE_RATE ms away from them
  *
  * @return None
  */
 void MAX6642_init( void );
 
-/**
- * @brief MAX6642 Monitor Task
- *
- * @param Parameters Pointer to parameter list passed to task upon initialization (not used here)
- */
-void vTaskMAX6642( void *Parameters );
-
 /**
  * @brief Reads MAX6642's local temperature value
  *
@@ -0,0 +1,196 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_filter.c
+ *
+ * @brief Sensor reading filters implementation
+ *
+ * @ingroup SENSOR_SCHED
+ */
+
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+
+/* C Standard includes */
+#include <string.h>
+
+/* Project Includes */
+#include "sdr.h"
+#include "sensor_filter.h"
+
+/* Signed readings are filtered with their sign bit flipped, which orders them as unsigned values */
+#define FILTER_BIAS(sensor)     ( ( (sensor)->signed_flag == SIGNED ) ? 0x80 : 0x00 )
+
+mmc_err sensor_filter_set( sensor_t * sensor, const sensor_filter_cfg_t * cfg )
+{
+    sensor_filter_t * filter;
+
+    if ( ( sensor == NULL ) || ( sensor->sdr_type != TYPE_01 ) || ( cfg == NULL ) ) {
+        return MMC_INVALID_ARG_ERR;
+    }
+
+    switch (cfg->type) {
+    case SENSOR_FILTER_NONE:
+        break;
+    case SENSOR_FILTER_EMA:
+        if ( ( cfg->param < 1 ) || ( cfg->param > 7 ) ) {
+            return MMC_INVALID_ARG_ERR;
+        }
+        break;
+    case SENSOR_FILTER_MEDIAN:
+        if ( ( cfg->param < 3 ) || ( cfg->param > SENSOR_FILTER_MEDIAN_MAX ) || !( cfg->param & 1 ) ) {
+            return MMC_INVALID_ARG_ERR;
+        }
+        break;
+    case SENSOR_FILTER_CONFIRM:
+        if ( cfg->param < 1 ) {
+            return MMC_INVALID_ARG_ERR;
+        }
+        break;
+    default:
+        return MMC_INVALID_ARG_ERR;
+    }
+
+    filter = sensor->filter;
+
+    if ( filter == NULL ) {
+        filter = pvPortMalloc( sizeof(sensor_filter_t) );
+
+        if ( filter == NULL ) {
+            return MMC_OOM_ERR;
+        }
+    }
+
+    memset( filter, 0, sizeof(sensor_filter_t) );
+    filter->cfg = cfg;
+
+    sensor->filter = filter;
+
+    return MMC_OK;
+}
+
+void sensor_filter_reset( sensor_t * sensor )
+{
+    sensor_filter_t * filter = sensor->filter;
+
+    if ( filter ) {
+        filter->primed = 0;
+        filter->pending = 0;
+        filter->fill = 0;
+        filter->pos = 0;
+    }
+}
+
+static uint8_t sensor_filter_median( sensor_filter_t * filter, uint8_t val )
+{
+    uint8_t sorted[SENSOR_FILTER_MEDIAN_MAX];
+    uint8_t i, j, tmp;
+
+    filter->window[filter->pos] = val;
+    if ( ++filter->pos == filter->cfg->param ) {
+        filter->pos = 0;
+    }
+    if ( filter->fill < filter->cfg->param ) {
+        filter->fill++;
+    }
+
+    /* A few readings at most, an insertion sort does */
+    for ( i = 0; i < filter->fill; i++ ) {
+        tmp = filter->window[i];
+        for ( j = i; ( j > 0 ) && ( sorted[j - 1] > tmp ); j-- ) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = tmp;
+    }
+
+    return sorted[filter->fill / 2];
+}
+
+static uint8_t sensor_filter_confirm( sensor_filter_t * filter, uint8_t val )
+{
+    uint8_t up = ( val > filter->out );
+
+    if ( val == filter->out ) {
+        filter->pending = 0;
+        return val;
+    }
+
+    /* Readings going back and forth around the value never get confirmed */
+    if ( ( filter->pending == 0 ) || ( up != filter->pending_up ) ) {
+        filter->pending = 0;
+        filter->pending_up = up;
+    }
+
+    if ( ++filter->pending < filter->cfg->param ) {
+        return filter->out;
+    }
+
+    filter->pending = 0;
+    return val;
+}
+
+void sensor_filter_apply( sensor_t * sensor )
+{
+    sensor_filter_t * filter = sensor->filter;
+    uint8_t bias;
+    uint8_t val;
+    uint8_t diff;
+
+    if ( filter == NULL ) {
+        return;
+    }
+
+    bias = FILTER_BIAS( sensor );
+    val = (uint8_t) sensor->readout_value ^ bias;
+
+    /* The filters start from the first reading */
+    if ( !filter->primed ) {
+        filter->primed = 1;
+        filter->out = val;
+        filter->acc = val << 8;
+    }
+
+    switch (filter->cfg->type) {
+    case SENSOR_FILTER_EMA:
+        /* The remainder left by the shift is under half a count, so the rounded average still reaches a steady reading */
+        if ( ( val << 8 ) >= filter->acc ) {
+            filter->acc += ( ( val << 8 ) - filter->acc ) >> filter->cfg->param;
+        } else {
+            filter->acc -= ( filter->acc - ( val << 8 ) ) >> filter->cfg->param;
+        }
+        val = ( filter->acc + 0x80 ) >> 8;
+        break;
+    case SENSOR_FILTER_MEDIAN:
+        val = sensor_filter_median( filter, val );
+        break;
+    case SENSOR_FILTER_CONFIRM:
+        val = sensor_filter_confirm( filter, val );
+        break;
+    default:
+        break;
+    }
+
+    diff = ( val > filter->out ) ? ( val - filter->out ) : ( filter->out - val );
+    if ( diff > filter->cfg->deadband ) {
+        filter->out = val;
+    }
+
+    sensor->readout_value = filter->out ^ bias;
+}
@@ -0,0 +1,103 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_filter.h
+ *
+ * @brief Sensor reading filters
+ *
+ * A threshold sensor polled by the sensor scheduler can have its readings filtered before its thresholds are checked, so
+ * a noisy rail close to a threshold doesn't send a stream of assertion and deassertion events. The filter is given next
+ * to the SDR entry, in the board sdr_list.c:
+ *
+ *     static const sensor_filter_cfg_t FMC1_12V_FILTER = { .type = SENSOR_FILTER_EMA, .param = 2, .deadband = 1 };
+ *
+ *     sensor_filter_set( sdr_insert_entry( TYPE_01, (void *) &SDR_FMC1_12V, &vTaskINA220_Handle, FMC1_12V_DEVID, CHIP_ID_INA_5 ),
+ *                        &FMC1_12V_FILTER );
+ *
+ * Get Sensor Reading returns the filtered value, the sensor history keeps the readings as they were taken.
+ *
+ * @ingroup SENSOR_SCHED
+ */
+
+#ifndef SENSOR_FILTER_H_
+#define SENSOR_FILTER_H_
+
+#include "sdr.h"
+#include "mmc_error.h"
+
+/**
+ * @brief Longest median filter window
+ */
+#define SENSOR_FILTER_MEDIAN_MAX        7
+
+/**
+ * @brief Filter types (sensor_filter_cfg_t::type)
+ */
+#define SENSOR_FILTER_NONE              0x00    /**< Readings used as they are, only the deadband applies */
+#define SENSOR_FILTER_EMA               0x01    /**< Exponential moving average, weight of a new reading 1/2^param (param 1 to 7) */
+#define SENSOR_FILTER_MEDIAN            0x02    /**< Median of the last param readings (odd, 3 to #SENSOR_FILTER_MEDIAN_MAX) */
+#define SENSOR_FILTER_CONFIRM           0x03    /**< A new value is taken once param readings in a row went the same way */
+
+/**
+ * @brief Filter configuration, usually a const object of the board
+ */
+typedef struct sensor_filter_cfg {
+    uint8_t type;           /**< Filter type, #SENSOR_FILTER_NONE... */
+    uint8_t param;          /**< Filter parameter, see the filter types */
+    uint8_t deadband;       /**< The value changes only if the filtered reading moved by more than this (in raw counts) */
+} sensor_filter_cfg_t;
+
+typedef struct sensor_filter {
+    const sensor_filter_cfg_t * cfg;
+    uint8_t primed;                             /**< Set once the first reading was taken */
+    uint8_t out;                                /**< Last value given, sign bit flipped for signed sensors */
+    uint16_t acc;                               /**< Moving average (8.8 fixed point) */
+    uint8_t pending;                            /**< Readings in a row away from the value, in the same direction */
+    uint8_t pending_up;                         /**< Direction of the pending readings */
+    uint8_t fill;                               /**< Readings in the median window */
+    uint8_t pos;                                /**< Next median window slot */
+    uint8_t window[SENSOR_FILTER_MEDIAN_MAX];   /**< Last readings, for the median */
+} sensor_filter_t;
+
+/**
+ * @brief Sets the filter of a sensor
+ *
+ * @param sensor Threshold based (type 01h) sensor, may be NULL (as returned by a failed #sdr_insert_entry)
+ * @param cfg Filter configuration, must stay valid
+ *
+ * @return MMC_OK, MMC_INVALID_ARG_ERR for a non threshold sensor or a bad parameter, MMC_OOM_ERR if there's no memory left
+ */
+mmc_err sensor_filter_set( sensor_t * sensor, const sensor_filter_cfg_t * cfg );
+
+/**
+ * @brief Restarts the filter of a sensor from its next reading
+ *
+ * @param sensor Sensor, nothing is done if it has no filter
+ */
+void sensor_filter_reset( sensor_t * sensor );
+
+/**
+ * @brief Filters the last reading of a sensor (sensor_t::readout_value) in place
+ *
+ * @param sensor Sensor just read, nothing is done if it has no filter
+ */
+void sensor_filter_apply( sensor_t * sensor );
+
+#endif
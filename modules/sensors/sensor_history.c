@@ -0,0 +1,237 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_history.c
+ *
+ * @brief Sensor reading history implementation
+ *
+ * @ingroup SENSOR_SCHED
+ */
+
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* C Standard includes */
+#include <string.h>
+
+/* Project Includes */
+#include "sdr.h"
+#include "ipmi.h"
+#include "sensor_history.h"
+
+/* Signed readings are kept with their sign bit flipped, which orders them as unsigned values */
+#define HISTORY_BIAS(sensor)    ( ( (sensor)->signed_flag == SIGNED ) ? 0x80 : 0x00 )
+
+/* Readings returned per Read request: the response data also holds the first sequence number and the count */
+#define SENSOR_HISTORY_CHUNK    ( IPMI_MSG_MAX_LENGTH - IPMB_RESP_HEADER_LENGTH - 1 - 3 )
+
+static void sensor_history_window_restart( sensor_history_t * hist )
+{
+    hist->win_min = 0xFF;
+    hist->win_max = 0x00;
+    hist->win_count = 0;
+    hist->win_sum = 0;
+}
+
+static void sensor_history_clear( sensor_history_t * hist, uint8_t decimation )
+{
+    hist->count = 0;
+    hist->decimation = decimation;
+    hist->skip = 0;
+    sensor_history_window_restart( hist );
+}
+
+void sensor_history_init( sensor_t * sensor )
+{
+    sensor_history_t * hist;
+
+    if ( ( sensor->sdr_type != TYPE_01 ) || sensor->history ) {
+        return;
+    }
+
+    hist = pvPortMalloc( sizeof(sensor_history_t) );
+
+    if ( hist == NULL ) {
+        return;
+    }
+
+    memset( hist, 0, sizeof(sensor_history_t) );
+    sensor_history_clear( hist, SENSOR_HISTORY_DECIMATION );
+
+    sensor->history = hist;
+}
+
+void sensor_history_record( sensor_t * sensor )
+{
+    sensor_history_t * hist = sensor->history;
+    uint8_t val;
+
+    if ( hist == NULL ) {
+        return;
+    }
+
+    val = (uint8_t) sensor->readout_value ^ HISTORY_BIAS( sensor );
+
+    /* Read by the IPMI task, which may preempt this one */
+    taskENTER_CRITICAL();
+
+    /* The window restarts by itself before its counters overflow */
+    if ( hist->win_count == UINT16_MAX ) {
+        sensor_history_window_restart( hist );
+    }
+
+    if ( val < hist->win_min ) {
+        hist->win_min = val;
+    }
+    if ( val > hist->win_max ) {
+        hist->win_max = val;
+    }
+    hist->win_sum += val;
+    hist->win_count++;
+
+    if ( hist->skip == 0 ) {
+        hist->samples[hist->seq & ( SENSOR_HISTORY_DEPTH - 1 )] = (uint8_t) sensor->readout_value;
+        hist->seq++;
+        if ( hist->count < SENSOR_HISTORY_DEPTH ) {
+            hist->count++;
+        }
+        hist->skip = hist->decimation;
+    }
+    hist->skip--;
+
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Sensor history, request: [0] sensor number, [1] function
+ *  - 0x00: Get statistics, [2] (optional) 1 to start a new window after this read
+ *          response: window readings (16 bits), minimum, maximum, mean (16 bits, 8.8 fixed point), history depth,
+ *          decimation, readings stored, next sequence number (16 bits)
+ *  - 0x01: Read, [2..3] first sequence number wanted (the oldest stored one is used if it is no longer available)
+ *          response: first sequence number returned (16 bits), readings count, readings (oldest first)
+ *  - 0x02: Set decimation, [2] readings per stored one (1 to 255), clears the history and the window
+ * The values are raw readings, 16 bits fields are little-endian.
+ */
+IPMI_HANDLER(ipmi_custom_cmd_get_sensor_history, NETFN_CUSTOM, IPMI_CUSTOM_CMD_GET_SENSOR_HISTORY, ipmi_msg *req, ipmi_msg *rsp)
+{
+    uint8_t len = rsp->data_len = 0;
+    sensor_history_t snap;
+    sensor_history_t * hist;
+    sensor_t * sensor;
+    uint16_t first;
+    uint16_t mean;
+    uint8_t bias;
+    uint8_t n;
+
+    if (req->data_len < 2) {
+        rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+        return;
+    }
+
+    sensor = find_sensor_by_id( req->data[0] );
+
+    if ( ( sensor == NULL ) || ( sensor->history == NULL ) ) {
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        return;
+    }
+
+    hist = sensor->history;
+    bias = HISTORY_BIAS( sensor );
+
+    switch (req->data[1]) {
+    case SENSOR_HISTORY_GET_STATS:
+        taskENTER_CRITICAL();
+        snap = *hist;
+        if ( ( req->data_len > 2 ) && ( req->data[2] & 0x01 ) ) {
+            sensor_history_window_restart( hist );
+        }
+        taskEXIT_CRITICAL();
+
+        if ( snap.win_count ) {
+            /* Rounded to the nearest 1/256, the bias is removed after the division so signed means stay exact */
+            mean = ( ( snap.win_sum << 8 ) + ( snap.win_count / 2 ) ) / snap.win_count;
+            mean -= bias << 8;
+        } else {
+            snap.win_min = snap.win_max = bias;
+            mean = 0;
+        }
+
+        rsp->data[len++] = snap.win_count & 0xFF;
+        rsp->data[len++] = snap.win_count >> 8;
+        rsp->data[len++] = snap.win_min ^ bias;
+        rsp->data[len++] = snap.win_max ^ bias;
+        rsp->data[len++] = mean & 0xFF;
+        rsp->data[len++] = mean >> 8;
+        rsp->data[len++] = SENSOR_HISTORY_DEPTH;
+        rsp->data[len++] = snap.decimation;
+        rsp->data[len++] = snap.count;
+        rsp->data[len++] = snap.seq & 0xFF;
+        rsp->data[len++] = snap.seq >> 8;
+        break;
+
+    case SENSOR_HISTORY_READ:
+        if (req->data_len < 4) {
+            rsp->completion_code = IPMI_CC_REQ_DATA_INV_LENGTH;
+            return;
+        }
+        first = req->data[2] | (req->data[3] << 8);
+
+        taskENTER_CRITICAL();
+        snap = *hist;
+        taskEXIT_CRITICAL();
+
+        /* Start from the oldest stored reading if the wanted one was overwritten (or is not written yet) */
+        if ( (uint16_t) ( snap.seq - first ) > snap.count ) {
+            first = snap.seq - snap.count;
+        }
+
+        n = snap.seq - first;
+        if ( n > SENSOR_HISTORY_CHUNK ) {
+            n = SENSOR_HISTORY_CHUNK;
+        }
+
+        rsp->data[len++] = first & 0xFF;
+        rsp->data[len++] = first >> 8;
+        rsp->data[len++] = n;
+        for ( uint8_t i = 0; i < n; i++ ) {
+            rsp->data[len++] = snap.samples[(uint16_t) ( first + i ) & ( SENSOR_HISTORY_DEPTH - 1 )];
+        }
+        break;
+
+    case SENSOR_HISTORY_SET_DECIMATION:
+        if ( (req->data_len < 3) || (req->data[2] == 0) ) {
+            rsp->completion_code = IPMI_CC_INV_DATA_FIELD_IN_REQ;
+            return;
+        }
+
+        taskENTER_CRITICAL();
+        sensor_history_clear( hist, req->data[2] );
+        taskEXIT_CRITICAL();
+        break;
+
+    default:
+        rsp->completion_code = IPMI_CC_PARAM_OUT_OF_RANGE;
+        return;
+    }
+
+    rsp->data_len = len;
+    rsp->completion_code = IPMI_CC_OK;
+}
@@ -0,0 +1,92 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_history.h
+ *
+ * @brief Sensor reading history
+ *
+ * Each threshold sensor polled by the sensor scheduler keeps its last readings (raw values, taken before the reading
+ * filter if any) in a ring, one every #SENSOR_HISTORY_DECIMATION readings by default. A statistics window follows every reading,
+ * decimated or not, with its minimum, maximum and mean, so short dips or spikes between two MCH polls are still seen.
+ *
+ * Both are read with the #IPMI_CUSTOM_CMD_GET_SENSOR_HISTORY command.
+ *
+ * @ingroup SENSOR_SCHED
+ */
+
+#ifndef SENSOR_HISTORY_H_
+#define SENSOR_HISTORY_H_
+
+#include "sdr.h"
+
+/**
+ * @brief Readings kept per sensor, must be a power of 2
+ */
+#ifndef SENSOR_HISTORY_DEPTH
+#define SENSOR_HISTORY_DEPTH            32
+#endif
+
+#if ( SENSOR_HISTORY_DEPTH & ( SENSOR_HISTORY_DEPTH - 1 ) ) || ( SENSOR_HISTORY_DEPTH > 128 )
+#error "SENSOR_HISTORY_DEPTH must be a power of 2, up to 128"
+#endif
+
+/**
+ * @brief Default number of readings per stored one
+ */
+#ifndef SENSOR_HISTORY_DECIMATION
+#define SENSOR_HISTORY_DECIMATION       1
+#endif
+
+/**
+ * @brief Sensor history command functions (second request byte)
+ */
+#define SENSOR_HISTORY_GET_STATS        0x00
+#define SENSOR_HISTORY_READ             0x01
+#define SENSOR_HISTORY_SET_DECIMATION   0x02
+
+typedef struct sensor_history {
+    uint16_t seq;                               /**< Sequence number of the next stored reading */
+    uint8_t count;                              /**< Readings stored, up to #SENSOR_HISTORY_DEPTH */
+    uint8_t decimation;                         /**< Readings per stored one */
+    uint8_t skip;                               /**< Readings left before the next one is stored */
+    uint8_t win_min;                            /**< Window minimum, sign bit flipped for signed sensors */
+    uint8_t win_max;                            /**< Window maximum, sign bit flipped for signed sensors */
+    uint16_t win_count;                         /**< Readings in the window */
+    uint32_t win_sum;                           /**< Sum of the window readings, sign bit flipped for signed sensors */
+    uint8_t samples[SENSOR_HISTORY_DEPTH];      /**< Reading ring, indexed by the sequence number */
+} sensor_history_t;
+
+/**
+ * @brief Allocates the history of a sensor
+ *
+ * Only threshold based (type 01h) sensors get one. A sensor is left without history if there is no memory left.
+ *
+ * @param sensor Sensor to record
+ */
+void sensor_history_init( sensor_t * sensor );
+
+/**
+ * @brief Records the last reading of a sensor (sensor_t::readout_value)
+ *
+ * @param sensor Sensor just read, nothing is done if it has no history
+ */
+void sensor_history_record( sensor_t * sensor );
+
+#endif
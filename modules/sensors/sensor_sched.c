@@ -0,0 +1,282 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @file sensor_sched.c
+ *
+ * @brief Sensor polling scheduler implementation
+ *
+ * @ingroup SENSOR_SCHED
+ */
+
+/* FreeRTOS Includes */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Project Includes */
+#include "sdr.h"
+#include "i2c.h"
+#include "task_priorities.h"
+#include "sensor_sched.h"
+#include "sensor_history.h"
+#include "sensor_filter.h"
+
+/* Sensors not found in the I2C mapping are read after all the others */
+#define SENSOR_SCHED_NO_BUS     0xFF
+
+/* True once the tick count t has been reached, the counter may have wrapped in between */
+#define SENSOR_SCHED_REACHED(now, t)    ( (int32_t) ( (now) - (t) ) >= 0 )
+
+/* Signed readings are compared with their sign bit flipped, which orders them as unsigned values */
+#define SENSOR_SCHED_BIAS(sensor)       ( ( (sensor)->signed_flag == SIGNED ) ? 0x80 : 0x00 )
+
+/* Polling schedule of a sensor, see sensor_t::sched */
+typedef struct sensor_sched_state {
+    TickType_t period;
+    TickType_t release; /* Time of the next reading, it is late once the following one is due */
+    TickType_t fast;
+    TickType_t slow;
+    uint8_t margin;
+    uint8_t last; /* Previous reading, sign bit flipped for signed sensors */
+    uint8_t primed; /* Set once there is a previous reading */
+    uint8_t bus_id;
+} sensor_sched_state_t;
+
+TaskHandle_t vTaskSensorSched_Handle;
+
+static const sensor_driver_t * sched_drivers[SENSOR_SCHED_MAX_DRIVERS];
+static uint8_t sched_driver_count;
+
+/* Longest sleep of the scheduler, so the sensors inserted later are read within a driver period */
+static TickType_t sched_max_sleep;
+
+void sensor_sched_register( const sensor_driver_t * driver )
+{
+    configASSERT( sched_driver_count < SENSOR_SCHED_MAX_DRIVERS );
+
+    sched_drivers[sched_driver_count++] = driver;
+}
+
+bool sensor_sched_set_rate( sensor_t * sensor, const sensor_sched_rate_t * rate )
+{
+    sensor_sched_state_t * state;
+
+    if ( ( sensor == NULL ) || ( rate == NULL ) ) {
+        return false;
+    }
+
+    /* The fast period must last at least a tick, the schedule being kept a multiple of it */
+    if ( ( pdMS_TO_TICKS( rate->fast ) == 0 ) || ( rate->slow < rate->fast ) || ( rate->margin == 0 ) ) {
+        return false;
+    }
+
+    sensor->rate = rate;
+
+    /* Already scheduled, the bounds were copied when it was first met. The reading goes back to fast until the next one. */
+    if ( sensor->sched ) {
+        sdr_task_lists_take();
+        state = sensor->sched;
+        state->fast = pdMS_TO_TICKS( rate->fast );
+        state->slow = pdMS_TO_TICKS( rate->slow );
+        state->margin = rate->margin;
+        state->period = state->fast;
+        state->primed = 0;
+        sdr_task_lists_give();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Picks the period of a sensor from its last reading
+ *
+ * The reading is moved towards the nearest threshold by as much as it changed since the previous one (scaled to the slow
+ * period), then the period goes from fast within the margin of the threshold to slow at twice the margin. It stays a
+ * multiple of the fast period, so the sensors of a driver are still released together.
+ */
+static void sensor_sched_adapt( sensor_t * sensor, sensor_sched_state_t * entry )
+{
+    uint8_t val = (uint8_t) sensor->readout_value ^ SENSOR_SCHED_BIAS( sensor );
+    uint32_t dist;
+    uint32_t move;
+
+    if ( entry->slow <= entry->fast ) {
+        return;
+    }
+
+    move = ( val > entry->last ) ? ( val - entry->last ) : ( entry->last - val );
+    move = entry->primed ? ( move * entry->slow / entry->period ) : 0;
+    entry->last = val;
+    entry->primed = 1;
+
+    dist = sensor_threshold_distance( sensor );
+    dist = ( dist > move ) ? ( dist - move ) : 0;
+
+    if ( dist <= entry->margin ) {
+        entry->period = entry->fast;
+    } else if ( dist >= 2 * entry->margin ) {
+        entry->period = entry->slow;
+    } else {
+        entry->period = entry->fast + ( entry->slow - entry->fast ) * ( dist - entry->margin ) / entry->margin;
+    }
+
+    entry->period -= entry->period % entry->fast;
+}
+
+/**
+ * @brief Sets up the schedule of a sensor the first time the scheduler meets it
+ *
+ * @return Sensor schedule, NULL if there's no memory left (the sensor is then tried again on the next cycle)
+ */
+static sensor_sched_state_t * sensor_sched_state( sensor_t * sensor, const sensor_driver_t * driver, TickType_t now )
+{
+    sensor_sched_state_t * state = sensor->sched;
+
+    if ( state ) {
+        return state;
+    }
+
+    state = pvPortMalloc( sizeof(sensor_sched_state_t) );
+
+    if ( state == NULL ) {
+        return NULL;
+    }
+
+    if ( sensor->rate ) {
+        state->fast = pdMS_TO_TICKS( sensor->rate->fast );
+        state->slow = pdMS_TO_TICKS( sensor->rate->slow );
+        state->margin = sensor->rate->margin;
+    } else {
+        state->fast = pdMS_TO_TICKS( driver->period );
+        state->slow = pdMS_TO_TICKS( driver->idle_period );
+        state->margin = SENSOR_SCHED_MARGIN;
+    }
+    /* Read it right away, then fast until the first reading tells how far the thresholds are */
+    state->period = state->fast;
+    state->release = now;
+    state->last = 0;
+    state->primed = 0;
+
+    if ( !i2c_get_chip_bus( sensor->chipid, &state->bus_id, NULL ) ) {
+        state->bus_id = SENSOR_SCHED_NO_BUS;
+    }
+
+    sensor_history_init( sensor );
+
+    sensor->sched = state;
+
+    return state;
+}
+
+void sensor_sched_init( void )
+{
+    uint8_t d;
+
+    if ( sched_driver_count == 0 ) {
+        return;
+    }
+
+    sched_max_sleep = portMAX_DELAY;
+    for ( d = 0; d < sched_driver_count; d++ ) {
+        if ( pdMS_TO_TICKS( sched_drivers[d]->period ) < sched_max_sleep ) {
+            sched_max_sleep = pdMS_TO_TICKS( sched_drivers[d]->period );
+        }
+    }
+
+    xTaskCreate( vTaskSensorSched, "SensorSched", SENSOR_SCHED_STACK_SIZE, (void *) NULL, tskSENSOR_PRIORITY, &vTaskSensorSched_Handle );
+}
+
+void vTaskSensorSched( void * Parameters )
+{
+    const sensor_driver_t * driver;
+    sensor_sched_state_t * state;
+    sensor_t * sensor;
+    TickType_t now;
+    TickType_t next;
+    uint8_t bus, next_bus;
+    uint8_t d;
+
+    for ( ;; ) {
+        now = xTaskGetTickCount();
+        next = now + sched_max_sleep;
+
+        /* The sensors are taken from the SDR lists on every cycle, so the ones inserted or removed later are followed */
+        sdr_task_lists_take();
+
+        /* Read the released sensors one bus after the other, keeping the accesses to a bus (and its mux setting) together */
+        for ( bus = 0; ; bus = next_bus ) {
+            next_bus = SENSOR_SCHED_NO_BUS;
+
+            for ( d = 0; d < sched_driver_count; d++ ) {
+                driver = sched_drivers[d];
+
+                for ( sensor = sdr_task_sensors( driver->monitor_task ); sensor != NULL; sensor = sensor->task_next ) {
+                    state = sensor_sched_state( sensor, driver, now );
+
+                    if ( ( state == NULL ) || !SENSOR_SCHED_REACHED( now, state->release ) ) {
+                        continue;
+                    }
+
+                    if ( state->bus_id != bus ) {
+                        if ( ( state->bus_id > bus ) && ( state->bus_id < next_bus ) ) {
+                            next_bus = state->bus_id;
+                        }
+                        continue;
+                    }
+
+                    /* A disabled sensor (e.g. on a board that isn't plugged in) keeps its schedule without being read */
+                    if ( ( sensor->event_scan & SENSOR_SCAN_ENABLED ) && ( driver->read( sensor ) == MMC_OK ) ) {
+                        sensor_history_record( sensor );
+                        sensor_filter_apply( sensor );
+                        sensor_threshold_check( sensor );
+                        sensor_sched_adapt( sensor, state );
+                    }
+
+                    state->release += state->period;
+
+                    /* Deadline missed (the next reading is already due): restart the period instead of reading it twice in a row */
+                    if ( SENSOR_SCHED_REACHED( xTaskGetTickCount(), state->release ) ) {
+                        state->release = xTaskGetTickCount() + state->period;
+                    }
+                }
+            }
+
+            /* The sensors out of the I2C mapping are read last */
+            if ( bus == SENSOR_SCHED_NO_BUS ) {
+                break;
+            }
+        }
+
+        /* Sleep until the next release */
+        for ( d = 0; d < sched_driver_count; d++ ) {
+            for ( sensor = sdr_task_sensors( sched_drivers[d]->monitor_task ); sensor != NULL; sensor = sensor->task_next ) {
+                if ( sensor->sched && SENSOR_SCHED_REACHED( next, sensor->sched->release ) ) {
+                    next = sensor->sched->release;
+                }
+            }
+        }
+
+        sdr_task_lists_give();
+
+        now = xTaskGetTickCount();
+        if ( !SENSOR_SCHED_REACHED( now, next ) ) {
+            vTaskDelay( next - now );
+        }
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ *   openMMC -- Open Source modular IPM Controller firmware
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   @license GPL-3.0+ <http://spdx.org/licenses/GPL-3.0+>
+ */
+
+/**
+ * @defgroup SENSOR_SCHED Sensor Scheduler
+ * @ingroup SENSORS
+ *
+ * A single task reads the sensors of every polled driver (LM75, MAX6642, MAX11609, INA220, INA3221). Each driver registers a
+ * #sensor_driver_t with its reading period and read function, and each of its sensors is then read once per period. The sensors
+ * due at the same time are read grouped by I2C bus.
+ *
+ * A driver (or a board, for a given sensor) may also give an idle period. A sensor is then read at the idle period while its
+ * reading is far from its thresholds, and more often as it gets closer to one of them or moves fast, down to the driver period
+ * within #SENSOR_SCHED_MARGIN counts of a threshold.
+ */
+
+/**
+ * @file sensor_sched.h
+ *
+ * @brief Sensor polling scheduler definitions
+ *
+ * @ingroup SENSOR_SCHED
+ */
+
+#ifndef SENSOR_SCHED_H_
+#define SENSOR_SCHED_H_
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sdr.h"
+#include "mmc_error.h"
+#include <stdbool.h>
+
+/**
+ * @brief Maximum number of drivers registered in the scheduler
+ */
+#define SENSOR_SCHED_MAX_DRIVERS        SDR_MAX_MONITOR_TASKS
+
+/**
+ * @brief Default distance to a threshold (in raw counts) under which a sensor is read at its fastest period
+ */
+#ifndef SENSOR_SCHED_MARGIN
+#define SENSOR_SCHED_MARGIN             8
+#endif
+
+/**
+ * @brief Stack depth of the scheduler task (in words), enough for the deepest driver read
+ */
+#define SENSOR_SCHED_STACK_SIZE         256
+
+/**
+ * @brief Polled sensor driver
+ */
+typedef struct sensor_driver {
+    const char * name;                      /**< Driver name, for debugging */
+    TaskHandle_t * monitor_task;            /**< Handle given to #sdr_insert_entry for the driver sensors, it only keys their
+                                             *   list (see #sdr_task_sensors), the task reading them is #vTaskSensorSched_Handle */
+    uint32_t period;                        /**< Reading period of each sensor (in ms) */
+    uint32_t idle_period;                   /**< Reading period of the sensors far from their thresholds (in ms), 0 to always
+                                             *   read them every period */
+    mmc_err (* read)( sensor_t * sensor );  /**< Reads the sensor and stores the converted value in sensor_t::readout_value */
+} sensor_driver_t;
+
+/**
+ * @brief Reading period bounds of a sensor, overriding the ones of its driver
+ */
+typedef struct sensor_sched_rate {
+    uint32_t fast;                          /**< Period close to a threshold or while the reading moves fast (in ms) */
+    uint32_t slow;                          /**< Period far from the thresholds (in ms), same as fast for a fixed period */
+    uint8_t margin;                         /**< Distance to the nearest threshold (in raw counts) under which the fast period
+                                             *   is used, the slow one is reached at twice this distance */
+} sensor_sched_rate_t;
+
+/**
+ * @brief Sensor scheduler task handle
+ */
+extern TaskHandle_t vTaskSensorSched_Handle;
+
+/**
+ * @brief Registers a polled sensor driver
+ *
+ * Must be called from the driver initialization in #sensor_init, before #sensor_sched_init.
+ *
+ * @param driver Driver description, must stay valid (usually a const object of the driver)
+ */
+void sensor_sched_register( const sensor_driver_t * driver );
+
+/**
+ * @brief Sets the reading period bounds of a sensor
+ *
+ * Usually called right after its #sdr_insert_entry in the board sdr_list.c. When the sensor is already scheduled, the new
+ * bounds replace the ones in use and the sensor is read at the fast period until its next reading.
+ *
+ * @param sensor Sensor, may be NULL (as returned by a failed #sdr_insert_entry)
+ * @param rate Period bounds, must stay valid (usually a const object of the board)
+ *
+ * @retval true Bounds set
+ * @retval false NULL sensor or rate, fast period shorter than a tick, slow period shorter than the fast one, or zero margin
+ */
+bool sensor_sched_set_rate( sensor_t * sensor, const sensor_sched_rate_t * rate );
+
+/**
+ * @brief Starts #vTaskSensorSched for the registered drivers
+ *
+ * No task is created if no driver was registered.
+ */
+void sensor_sched_init( void );
+
+/**
+ * @brief Sensor scheduler task
+ *
+ * Reads each sensor when its period has elapsed, then filters the reading (see #sensor_filter_apply) and checks its
+ * thresholds (see #sensor_threshold_check). The sensors due in the same cycle are read in bus order, and the task sleeps
+ * until the next one is due. Sensors with their scanning disabled (see #sdr_disable_sensors) are not read.
+ *
+ * The sensors are taken from the driver lists of the SDR repository on every cycle, holding #sdr_task_lists_take, so the
+ * ones inserted after the initialization (e.g. RTM sensors) are read too, and the removed ones are not freed while in use.
+ *
+ * @param Parameters Pointer to parameter list passed to task upon initialization (not used here)
+ */
+void vTaskSensorSched( void * Parameters );
+
+#endif
@@ -35,13 +35,11 @@
 
 #define tskSENSOR_PRIORITY              (tskIDLE_PRIORITY+3)
 #define tskHOTSWAP_PRIORITY             (tskIDLE_PRIORITY+3)
-#define tskLM75SENSOR_PRIORITY          (tskIDLE_PRIORITY+3)
-#define tskMAX6642SENSOR_PRIORITY       (tskIDLE_PRIORITY+3)
-#define tskINA220SENSOR_PRIORITY        (tskIDLE_PRIORITY+3)
-#define tskINA3221SENSOR_PRIORITY       (tskIDLE_PRIORITY+3)
-#define tskMAX11609SENSOR_PRIORITY      (tskIDLE_PRIORITY+3)
+#define tskIPMI_DEFERRED_PRIORITY       (tskIDLE_PRIORITY+3)
+#define tskIPMI_EVENT_PRIORITY          (tskIDLE_PRIORITY+3)
 
 #define tskIPMI_HANDLERS_PRIORITY       (tskIDLE_PRIORITY+4)
+#define tskI2C_BUS_PRIORITY             (tskIDLE_PRIORITY+4)
 #define tskIPMI_PRIORITY                (tskIDLE_PRIORITY+4)
 
 #define tskIPMB_RX_PRIORITY             (tskIDLE_PRIORITY+5)
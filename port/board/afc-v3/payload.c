@@ -108,14 +108,13 @@ uint8_t payload_check_pgood( uint8_t *pgood_flag )
 
     extern const SDR_type_01h_t SDR_FMC1_12V;
 
-    /* Iterate through the SDR Table to find all the LM75 entries */
-    for ( p_sensor = sdr_head; (p_sensor != NULL) || (p_sensor->task_handle == NULL); p_sensor = p_sensor->next) {
-        if (p_sensor->sdr == &SDR_FMC1_12V) {
-            sdr = ( SDR_type_01h_t * ) p_sensor->sdr;
-            *pgood_flag = ( ( p_sensor->readout_value >= (sdr->lower_critical_thr ) ) &&
-                            ( p_sensor->readout_value <= (sdr->upper_critical_thr ) ) );
-            return 1;
-        }
+    p_sensor = find_sensor_by_sdr( (void *) &SDR_FMC1_12V );
+
+    if ( p_sensor ) {
+        sdr = ( SDR_type_01h_t * ) p_sensor->sdr;
+        *pgood_flag = ( ( p_sensor->readout_value >= (sdr->lower_critical_thr ) ) &&
+                        ( p_sensor->readout_value <= (sdr->upper_critical_thr ) ) );
+        return 1;
     }
 
     return 0;
@@ -400,7 +399,7 @@ uint8_t payload_hpm_prepare_comp( void )
     hpm_page_addr = 0;
 
     /* Initialize flash */
-    ssp_init( FLASH_SPI, FLASH_SPI_BITRATE, FLASH_SPI_FRAME_SIZE, SSP_MASTER, SSP_INTERRUPT );
+    ssp_init( FLASH_SPI, FLASH_SPI_BITRATE, FLASH_SPI_FRAME_SIZE, SSP_MASTER, SSP_DMA );
 
     /* Prevent the FPGA from accessing the Flash to configure itself now */
     gpio_set_pin_state( PIN_PORT(GPIO_FPGA_PROGRAM_B), PIN_NUMBER(GPIO_FPGA_PROGRAM_B), GPIO_LEVEL_HIGH );
@@ -3,8 +3,8 @@
 #include "port.h"
 
 i2c_mux_state_t i2c_mux[I2C_MUX_CNT] = {
-    { I2C1, -1, 0 },
-    { I2C2, -1, 0 }
+    { I2C1, I2C_MUX_STATE_UNKNOWN, 0 },
+    { I2C2, I2C_MUX_STATE_UNKNOWN, 0 }
 };
 
 i2c_bus_mapping_t i2c_bus_map[I2C_BUS_CNT] = {
@@ -72,7 +72,7 @@ bool i2c_set_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux, int8_t new_state
     return true;
 }
 
-uint8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux )
+int8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux )
 {
     if (i2c_mux->i2c_interface == i2c_bus_map[i2c_chip_map[CHIP_ID_MUX].bus_id].i2c_interface) {
         /* Include enable bit (fourth bit) on channel selection byte */
@@ -80,15 +80,21 @@ uint8_t i2c_get_mux_bus( uint8_t bus_id, i2c_mux_state_t *i2c_mux )
 
         portENABLE_INTERRUPTS();
         /* Read bus state (other master on the bus may have switched it */
-        xI2CMasterRead( i2c_bus_map[i2c_chip_map[CHIP_ID_MUX].bus_id].i2c_interface, i2c_chip_map[CHIP_ID_MUX].i2c_address, &tca_channel, 1 );
+        if( xI2CMasterRead( i2c_bus_map[i2c_chip_map[CHIP_ID_MUX].bus_id].i2c_interface, i2c_chip_map[CHIP_ID_MUX].i2c_address, &tca_channel, 1 ) != 1 ) {
+            return I2C_MUX_STATE_UNKNOWN;
+        }
 
         /* Convert bit position from tca register to actual channel number */
         uint8_t num;
-        for (num = 0; num <= 8 ; num++)
+        for (num = 0; num < 8 ; num++)
         {
         	if (tca_channel & 1 << num)
         		break;
         }
+        if (num == 8) {
+            /* No channel enabled */
+            return I2C_MUX_STATE_UNKNOWN;
+        }
         return num;
 
     } else {
@@ -42,7 +42,7 @@
  *
  * @return
  */
-IPMI_HANDLER(ipmi_oem_cmd_i2c_transfer, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_I2C_TRANSFER, ipmi_msg *req, ipmi_msg* rsp)
+IPMI_DEFERRED_REPLAYED_HANDLER(ipmi_oem_cmd_i2c_transfer, NETFN_CUSTOM_OEM, IPMI_OEM_CMD_I2C_TRANSFER, ipmi_msg *req, ipmi_msg* rsp)
 {
     uint8_t bus_id = req->data[0];
     uint8_t chipid_sel = req->data[1];
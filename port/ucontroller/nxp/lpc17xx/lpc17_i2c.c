@@ -27,6 +27,9 @@
 
 #include "port.h"
 #include "string.h"
+#include "task.h"
+#include "semphr.h"
+#include "modules/i2c.h"
 
 #define SLAVE_MASK 0xFF
 
@@ -59,6 +62,143 @@ void I2C2_IRQHandler(void)
     i2c_state_handling(I2C2);
 }
 
+/* Rough busy-wait iterations per millisecond, for the waits made before the scheduler runs (the tick count doesn't move) */
+#define i2cSPIN_PER_MS          (SystemCoreClock / 1000 / 8)
+
+static LPC_I2C_T * const i2c_regs[I2C_NUM_INTERFACE] = { LPC_I2C0, LPC_I2C1, LPC_I2C2 };
+
+static const struct {
+    IRQn_Type irq;
+    uint32_t sda;
+    uint32_t scl;
+} i2c_pins[I2C_NUM_INTERFACE] = {
+    [I2C0] = { I2C0_IRQn, I2C0_SDA, I2C0_SCL },
+    [I2C1] = { I2C1_IRQn, I2C1_SDA, I2C1_SCL },
+    [I2C2] = { I2C2_IRQn, I2C2_SDA, I2C2_SCL },
+};
+
+uint32_t i2c_timeout_count[I2C_NUM_INTERFACE];
+uint32_t i2c_bus_err_count[I2C_NUM_INTERFACE];
+uint32_t i2c_recovery_count[I2C_NUM_INTERFACE];
+
+/* Given by the interrupt when a master transfer is over */
+static SemaphoreHandle_t i2c_master_done[I2C_NUM_INTERFACE];
+/* Same, polled before the scheduler runs */
+static volatile uint8_t i2c_master_finished[I2C_NUM_INTERFACE];
+
+static void i2c_slave_restart(I2C_ID_T id);
+
+static void i2c_recovery_delay( void )
+{
+    /* Half a 100 kHz SCL period, at least */
+    for (volatile uint32_t n = (SystemCoreClock / 1000000) * 5 / 4; n > 0; n--) {}
+}
+
+void vI2CBusRecover( I2C_ID_T id )
+{
+    uint8_t sda_port = PIN_PORT(i2c_pins[id].sda), sda_pin = PIN_NUMBER(i2c_pins[id].sda);
+    uint8_t scl_port = PIN_PORT(i2c_pins[id].scl), scl_pin = PIN_NUMBER(i2c_pins[id].scl);
+
+    NVIC_DisableIRQ(i2c_pins[id].irq);
+
+    /* The disabled controller drops its START/STOP requests and releases the lines, they are then driven by hand */
+    Chip_I2C_Disable(id);
+    i2c_regs[id]->CONCLR = I2C_I2CONCLR_AAC | I2C_I2CONCLR_SIC | I2C_I2CONCLR_STAC;
+
+    gpio_set_pin_state(scl_port, scl_pin, 1);
+    gpio_set_pin_dir(scl_port, scl_pin, GPIO_DIR_OUTPUT);
+    gpio_set_pin_dir(sda_port, sda_pin, GPIO_DIR_INPUT);
+    Chip_IOCON_PinMux(LPC_IOCON, scl_port, scl_pin, IOCON_MODE_INACT, IOCON_FUNC0);
+    Chip_IOCON_PinMux(LPC_IOCON, sda_port, sda_pin, IOCON_MODE_INACT, IOCON_FUNC0);
+
+    /* A slave holding SDA low lets it go once it is clocked to the end of its byte */
+    for (uint8_t i = 0; (i < 9) && !gpio_read_pin(sda_port, sda_pin); i++) {
+        gpio_set_pin_state(scl_port, scl_pin, 0);
+        i2c_recovery_delay();
+        gpio_set_pin_state(scl_port, scl_pin, 1);
+        i2c_recovery_delay();
+    }
+
+    /* STOP condition: SDA rising while SCL is high */
+    gpio_set_pin_state(sda_port, sda_pin, 0);
+    gpio_set_pin_dir(sda_port, sda_pin, GPIO_DIR_OUTPUT);
+    i2c_recovery_delay();
+    gpio_set_pin_state(sda_port, sda_pin, 1);
+    i2c_recovery_delay();
+    gpio_set_pin_dir(sda_port, sda_pin, GPIO_DIR_INPUT);
+
+    Chip_IOCON_PinMuxSet(LPC_IOCON, sda_port, sda_pin, PIN_FUNC(i2c_pins[id].sda));
+    Chip_IOCON_PinMuxSet(LPC_IOCON, scl_port, scl_pin, PIN_FUNC(i2c_pins[id].scl));
+
+    Chip_I2C_Enable(id);
+    /* The disabled controller stopped acknowledging our slave address, and may have cut a message off */
+    i2c_slave_restart(id);
+    NVIC_ClearPendingIRQ(i2c_pins[id].irq);
+    NVIC_EnableIRQ(i2c_pins[id].irq);
+
+    /* The mux may have missed the end of its write, or reset */
+    i2c_mux_invalidate(id);
+
+    i2c_recovery_count[id]++;
+}
+
+/*
+ * Master transfer events: the task starting a transfer sleeps until the interrupt driven state machine is done with it,
+ * instead of spinning on the transfer status as Chip_I2C_EventHandler does. The wait, and the one for the STOP condition
+ * that follows it, are bounded: past i2cMASTER_TIMEOUT_MS the bus is recovered and the transfer ends with I2C_STATUS_BUSY.
+ */
+static void I2C_Master_Event(I2C_ID_T id, I2C_EVENT_T event)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    bool running = (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+    bool done;
+    uint32_t n;
+
+    switch (event) {
+    case I2C_EVENT_LOCK:
+        /* Forget the completion of a transfer that timed out just before it was notified */
+        i2c_master_finished[id] = 0;
+        if (running) {
+            xSemaphoreTake(i2c_master_done[id], 0);
+        }
+        break;
+
+    case I2C_EVENT_WAIT:
+        if (running) {
+            done = (xSemaphoreTake(i2c_master_done[id], pdMS_TO_TICKS(i2cMASTER_TIMEOUT_MS)) == pdTRUE);
+        } else {
+            /* Nothing can block before the scheduler is started (e.g. FRU EEPROM read during the initialization) */
+            for (n = i2cMASTER_TIMEOUT_MS * i2cSPIN_PER_MS; (n > 0) && !i2c_master_finished[id]; n--) {}
+            done = i2c_master_finished[id];
+        }
+
+        /* The driver then waits for the STOP to be sent, which never happens while a slave holds SCL low */
+        n = i2cSPIN_PER_MS;
+        while (done && (i2c_regs[id]->CONSET & I2C_I2CONSET_STO)) {
+            if (n-- == 0) {
+                done = false;
+            }
+        }
+
+        if (!done) {
+            i2c_timeout_count[id]++;
+            vI2CBusRecover(id);
+        }
+        break;
+
+    case I2C_EVENT_DONE:
+        i2c_master_finished[id] = 1;
+        if (running) {
+            xSemaphoreGiveFromISR(i2c_master_done[id], &xHigherPriorityTaskWoken);
+            portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
 void vI2CConfig( I2C_ID_T id, uint32_t speed )
 {
     IRQn_Type irq;
@@ -91,46 +231,33 @@ void vI2CConfig( I2C_ID_T id, uint32_t speed )
     NVIC_EnableIRQ( irq );
     Chip_I2C_Enable( id );
 
-    Chip_I2C_SetMasterEventHandler(id, Chip_I2C_EventHandler);
+    if (i2c_master_done[id] == NULL) {
+        i2c_master_done[id] = xSemaphoreCreateBinary();
+    }
+    Chip_I2C_SetMasterEventHandler(id, I2C_Master_Event);
 }
 
-static TaskHandle_t slave_task_id;
 I2C_XFER_T slave_cfg;
 I2C_XFER_T slave_dummy;
-uint8_t recv_msg[i2cMAX_MSG_LENGTH];
 uint8_t recv_msg_dummy[i2cMAX_MSG_LENGTH];
-uint8_t recv_bytes;
 
-uint8_t xI2CSlaveReceive( I2C_ID_T id, uint8_t * rx_buff, uint8_t buff_len, uint32_t timeout )
-{
-    uint8_t bytes_to_copy = 0;
-    slave_task_id = xTaskGetCurrentTaskHandle();
-
-    if ( ulTaskNotifyTake( pdTRUE, timeout ) == pdTRUE )
-    {
-        if (recv_bytes > buff_len) {
-            bytes_to_copy = buff_len;
-        } else {
-            bytes_to_copy = recv_bytes;
-        }
-        /* Copy the rx buffer to the pointer given */
-        memcpy( rx_buff, &recv_msg[0], bytes_to_copy );
-        return bytes_to_copy;
-    } else {
-        return 0;
-    }
-}
+/* Start of the buffer being filled (lpcopen advances slave_cfg.rxBuff while receiving) */
+static uint8_t *slave_rx_buff;
+static uint8_t slave_rx_len;
+static i2c_slave_rx_cb_t slave_rx_cb;
+/* Interface the slave receiver runs on, I2C_NUM_INTERFACE if none */
+static I2C_ID_T slave_id = I2C_NUM_INTERFACE;
 
 static void I2C_Slave_Event(I2C_ID_T id, I2C_EVENT_T event)
 {
-    static BaseType_t xHigherPriorityTaskWoken;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
     switch (event) {
     case I2C_EVENT_DONE:
-        recv_bytes = i2cMAX_MSG_LENGTH - slave_cfg.rxSz;
-        slave_cfg.rxSz = i2cMAX_MSG_LENGTH;
-        slave_cfg.rxBuff = &recv_msg[0];
+        /* Hand the filled buffer over and receive the next message wherever the callback tells us */
+        slave_rx_buff = slave_rx_cb( slave_rx_buff, slave_rx_len - slave_cfg.rxSz, &xHigherPriorityTaskWoken );
+        slave_cfg.rxSz = slave_rx_len;
+        slave_cfg.rxBuff = slave_rx_buff;
 
-        vTaskNotifyGiveFromISR( slave_task_id, &xHigherPriorityTaskWoken );
         portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 
     case I2C_EVENT_SLAVE_RX:
@@ -148,15 +275,20 @@ static void I2C_Slave_Event(I2C_ID_T id, I2C_EVENT_T event)
  */
 static void I2C_Dummy_Event(I2C_ID_T id, I2C_EVENT_T event){}
 
-void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr )
+void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr, uint8_t * rx_buff, uint8_t buff_len, i2c_slave_rx_cb_t rx_cb )
 {
+    slave_id = id;
+    slave_rx_buff = rx_buff;
+    slave_rx_len = buff_len;
+    slave_rx_cb = rx_cb;
+
     /* expects i2c addr < 0x80 */
     slave_addr <<= 1;
     slave_cfg.slaveAddr = slave_addr;
     slave_cfg.txBuff = NULL; /* Not using Slave transmitter right now */
     slave_cfg.txSz = 0;
-    slave_cfg.rxBuff = &recv_msg[0];
-    slave_cfg.rxSz = (sizeof(recv_msg)/sizeof(recv_msg[0]));
+    slave_cfg.rxBuff = rx_buff;
+    slave_cfg.rxSz = buff_len;
     Chip_I2C_SlaveSetup( id, I2C_SLAVE_0, &slave_cfg, I2C_Slave_Event, SLAVE_MASK);
 
     slave_dummy.slaveAddr = 0;
@@ -167,14 +299,117 @@ void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr )
     Chip_I2C_SlaveSetup( id, I2C_SLAVE_GENERAL, &slave_dummy, I2C_Dummy_Event, SLAVE_MASK);
 }
 
+/* Drops the message being received, if any, and receives the next one from the start of the current buffer */
+static void i2c_slave_restart(I2C_ID_T id)
+{
+    if (id != slave_id) {
+        return;
+    }
+
+    slave_cfg.rxBuff = slave_rx_buff;
+    slave_cfg.rxSz = slave_rx_len;
+    slave_dummy.rxBuff = recv_msg_dummy;
+    slave_dummy.rxSz = (sizeof(recv_msg_dummy)/sizeof(recv_msg_dummy[0]));
+
+    /* Sets AA back, or lets Chip_I2C_MasterTransfer do it when called while one of its transfers is being recovered */
+    Chip_I2C_SlaveAbort(id);
+}
+
+uint32_t i2c_arb_lost_count[I2C_NUM_INTERFACE];
+
+/*
+ * Master write then read, restarted when the bus arbitration is lost, at most i2cMAX_ARB_LOST_RETRIES times. The transfer
+ * is left in xfer, so the callers can tell how many bytes went through. The mux channel is forgotten on any failure, and
+ * as soon as another master won the bus, since it may have switched the mux.
+ */
+static I2C_STATUS_T i2c_master_transfer(I2C_ID_T id, I2C_XFER_T *xfer, uint8_t addr, const uint8_t *tx_buff, int tx_len, uint8_t *rx_buff, int rx_len)
+{
+    I2C_STATUS_T status = I2C_STATUS_ARBLOST;
+    uint8_t attempts;
+
+    for (attempts = 0; (attempts < i2cMAX_ARB_LOST_RETRIES) && (status == I2C_STATUS_ARBLOST); attempts++) {
+        /* Restart the whole transfer, the failed attempt may have moved the buffer pointers */
+        xfer->slaveAddr = addr;
+        xfer->txBuff = tx_buff;
+        xfer->txSz = tx_len;
+        xfer->rxBuff = rx_buff;
+        xfer->rxSz = rx_len;
+
+        status = Chip_I2C_MasterTransfer(id, xfer);
+        if (status == I2C_STATUS_ARBLOST) {
+            i2c_arb_lost_count[id]++;
+        } else if (status == I2C_STATUS_BUSERR) {
+            i2c_bus_err_count[id]++;
+        }
+    }
+
+    if ((status != I2C_STATUS_DONE) || (xfer->txSz != 0) || (xfer->rxSz != 0) || (attempts > 1)) {
+        i2c_mux_invalidate(id);
+    }
+    return status;
+}
+
 int xI2CMasterWriteRead(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, int tx_len, uint8_t *rx_buff, int rx_len)
 {
     I2C_XFER_T xfer = {0};
+
+    i2c_master_transfer(id, &xfer, addr, tx_buff, tx_len, rx_buff, rx_len);
+    return rx_len - xfer.rxSz;
+}
+
+I2C_STATUS_T xI2CMasterWriteReadStatus(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, int tx_len, uint8_t *rx_buff, int rx_len, int *rx_count)
+{
+    I2C_XFER_T xfer = {0};
+    I2C_STATUS_T status;
+
+    status = i2c_master_transfer(id, &xfer, addr, tx_buff, tx_len, rx_buff, rx_len);
+
+    if ((status == I2C_STATUS_DONE) && ((xfer.txSz != 0) || (xfer.rxSz != 0))) {
+        /* Not all bytes were transferred */
+        status = I2C_STATUS_NAK;
+    }
+    if (rx_count) {
+        *rx_count = rx_len - xfer.rxSz;
+    }
+    return status;
+}
+
+I2C_STATUS_T xI2CMasterWriteStatus(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, int tx_len)
+{
+    I2C_XFER_T xfer = {0};
+    I2C_STATUS_T status;
+
     xfer.slaveAddr = addr;
     xfer.txBuff = tx_buff;
     xfer.txSz = tx_len;
-    xfer.rxBuff = rx_buff;
-    xfer.rxSz = rx_len;
-    while (Chip_I2C_MasterTransfer(id, &xfer) == I2C_STATUS_ARBLOST) {}
+
+    status = Chip_I2C_MasterTransfer(id, &xfer);
+    if (status == I2C_STATUS_ARBLOST) {
+        i2c_arb_lost_count[id]++;
+    } else if (status == I2C_STATUS_BUSERR) {
+        i2c_bus_err_count[id]++;
+    } else if ((status == I2C_STATUS_DONE) && (xfer.txSz != 0)) {
+        /* Not all bytes were acknowledged */
+        status = I2C_STATUS_NAK;
+    }
+    if (status != I2C_STATUS_DONE) {
+        i2c_mux_invalidate(id);
+    }
+    return status;
+}
+
+int xI2CMasterWrite(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, uint8_t tx_len)
+{
+    I2C_XFER_T xfer = {0};
+
+    i2c_master_transfer(id, &xfer, addr, tx_buff, tx_len, NULL, 0);
+    return tx_len - xfer.txSz;
+}
+
+int xI2CMasterRead(I2C_ID_T id, uint8_t addr, uint8_t *rx_buff, int rx_len)
+{
+    I2C_XFER_T xfer = {0};
+
+    i2c_master_transfer(id, &xfer, addr, NULL, 0, rx_buff, rx_len);
     return rx_len - xfer.rxSz;
 }
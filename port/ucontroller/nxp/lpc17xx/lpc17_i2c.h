@@ -25,13 +25,103 @@
  * @brief I2C driver for LPC17xx
  */
 
+#include "FreeRTOS.h"
+
 /*! @brief Max message length (in bits) used in I2C */
 #define i2cMAX_MSG_LENGTH               32
 
-#define xI2CMasterWrite(id, addr, tx_buff, tx_len) Chip_I2C_MasterSend(id, addr, tx_buff, tx_len)
-#define xI2CMasterRead(id, addr, rx_buff, rx_len) Chip_I2C_MasterRead(id, addr, rx_buff, rx_len)
+/**
+ * @brief Blocking master write, a failed transfer makes the mux channel of the interface be read back (see #i2c_mux_invalidate)
+ *
+ * The transfer is restarted when the bus arbitration is lost, at most #i2cMAX_ARB_LOST_RETRIES times.
+ *
+ * @return Amount of bytes written
+ */
+int xI2CMasterWrite(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, uint8_t tx_len);
 
-uint8_t xI2CSlaveReceive( I2C_ID_T id, uint8_t * rx_buff, uint8_t buff_len, uint32_t timeout );
-void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr );
+/**
+ * @brief Blocking master read, a failed transfer makes the mux channel of the interface be read back (see #i2c_mux_invalidate)
+ *
+ * The transfer is restarted when the bus arbitration is lost, at most #i2cMAX_ARB_LOST_RETRIES times.
+ *
+ * @return Amount of bytes read
+ */
+int xI2CMasterRead(I2C_ID_T id, uint8_t addr, uint8_t *rx_buff, int rx_len);
+
+/**
+ * @brief I2C slave receive callback, called from the I2C interrupt when a write addressed to us is finished
+ *
+ * @param rx_buff Buffer holding the received bytes
+ * @param rx_len Amount of bytes received
+ * @param pxHigherPriorityTaskWoken Must be set to pdTRUE if a higher priority task was unblocked by the callback
+ *
+ * @return Buffer which will receive the next message (at least as long as the one given to #vI2CSlaveSetup)
+ */
+typedef uint8_t * (* i2c_slave_rx_cb_t)( uint8_t * rx_buff, uint8_t rx_len, BaseType_t * pxHigherPriorityTaskWoken );
+
+/**
+ * @brief Configures the I2C slave receiver
+ *
+ * Incoming messages are written directly to the given buffer, no copy is made by the driver.
+ *
+ * @param id I2C interface
+ * @param slave_addr 7-bit slave address
+ * @param rx_buff Buffer which will receive the first message
+ * @param buff_len Length of every receive buffer
+ * @param rx_cb Callback which takes each received message and provides the next buffer
+ */
+void vI2CSlaveSetup ( I2C_ID_T id, uint8_t slave_addr, uint8_t * rx_buff, uint8_t buff_len, i2c_slave_rx_cb_t rx_cb );
 void vI2CConfig( I2C_ID_T id, uint32_t speed );
+/*! @brief Attempts made by the blocking master transfer functions when the bus arbitration is lost */
+#define i2cMAX_ARB_LOST_RETRIES         8
+
+/*! @brief Arbitration losses seen by the master transfer functions, per interface */
+extern uint32_t i2c_arb_lost_count[I2C_NUM_INTERFACE];
+
+/*! @brief Longest time a master transfer may take (including its STOP condition) before the bus is recovered */
+#ifndef i2cMASTER_TIMEOUT_MS
+#define i2cMASTER_TIMEOUT_MS            50
+#endif
+
+/*! @brief Master transfers which did not end in time, per interface */
+extern uint32_t i2c_timeout_count[I2C_NUM_INTERFACE];
+
+/*! @brief Bus errors (misplaced START or STOP) seen by the master transfer functions, per interface */
+extern uint32_t i2c_bus_err_count[I2C_NUM_INTERFACE];
+
+/*! @brief Bus recoveries run, per interface */
+extern uint32_t i2c_recovery_count[I2C_NUM_INTERFACE];
+
+/**
+ * @brief Recovers a stuck I2C bus
+ *
+ * The controller is disabled, up to 9 clocks are sent on SCL until the slave holding SDA low releases it, then a STOP
+ * condition is sent by hand and the controller is enabled back. Every master transfer running past #i2cMASTER_TIMEOUT_MS
+ * ends this way, with the I2C_STATUS_BUSY status.
+ *
+ * @param id I2C interface, must not be used by a transfer of another task
+ */
+void vI2CBusRecover( I2C_ID_T id );
+
 int xI2CMasterWriteRead(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, int tx_len, uint8_t *rx_buff, int rx_len);
+
+/**
+ * @brief Master write then read (after a repeated start), reporting why it failed
+ *
+ * Either part may be empty. The transfer is restarted when the bus arbitration is lost, as #xI2CMasterWriteRead does.
+ *
+ * @param rx_count Pointer to variable that will hold the amount of bytes read (may be NULL)
+ *
+ * @return I2C_STATUS_DONE if all bytes were transferred, I2C_STATUS_NAK if some were not, I2C_STATUS_BUSY if the transfer
+ * timed out, or the failure status
+ */
+I2C_STATUS_T xI2CMasterWriteReadStatus(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, int tx_len, uint8_t *rx_buff, int rx_len, int *rx_count);
+
+/**
+ * @brief Single attempt master write, reporting why it failed
+ *
+ * Unlike #xI2CMasterWrite, the transfer isn't retried when the bus arbitration is lost, so the caller can schedule the retry.
+ *
+ * @return I2C_STATUS_DONE if all bytes were sent and acknowledged, I2C_STATUS_ARBLOST if another master won the bus, or the failure status
+ */
+I2C_STATUS_T xI2CMasterWriteStatus(I2C_ID_T id, uint8_t addr, const uint8_t *tx_buff, int tx_len);
@@ -34,12 +34,16 @@ static ssp_config_t ssp_cfg[MAX_SSP_INTERFACES] = {
         .lpc_id = LPC_SSP0,
         .irq = SSP0_IRQn,
         .ssel_pin = SSP0_SSEL,
+        .dma_tx_conn = GPDMA_CONN_SSP0_Tx,
+        .dma_rx_conn = GPDMA_CONN_SSP0_Rx,
     },
 #ifdef MODULE_FLASH_SPI
     [FLASH_SPI] = {
         .lpc_id = LPC_SSP1,
         .irq = SSP1_IRQn,
         .ssel_pin = SSP1_SSEL,
+        .dma_tx_conn = GPDMA_CONN_SSP1_Tx,
+        .dma_rx_conn = GPDMA_CONN_SSP1_Rx,
     }
 #endif
 };
@@ -88,6 +92,33 @@ void SSP1_IRQHandler( void )
     ssp_irq_handler(LPC_SSP1);
 }
 
+/* The transfer is over once the last frame is received, the transmit channel completion is only acknowledged */
+void DMA_IRQHandler( void )
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    for (uint8_t i = 0; i < MAX_SSP_INTERFACES; i++) {
+        if (!ssp_cfg[i].dma_busy) {
+            continue;
+        }
+
+        Chip_GPDMA_Interrupt(LPC_GPDMA, ssp_cfg[i].dma_tx_ch);
+
+        if (Chip_GPDMA_IntGetStatus(LPC_GPDMA, GPDMA_STAT_INT, ssp_cfg[i].dma_rx_ch)) {
+            Chip_GPDMA_Interrupt(LPC_GPDMA, ssp_cfg[i].dma_rx_ch);
+
+            Chip_SSP_DMA_Disable(ssp_cfg[i].lpc_id);
+            ssp_cfg[i].dma_busy = 0;
+
+            /* Deassert SSEL pin, then notify the caller task */
+            ssp_ssel_control(i, DEASSERT);
+            vTaskNotifyGiveFromISR(ssp_cfg[i].caller_task, &xHigherPriorityTaskWoken);
+        }
+    }
+
+    portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+}
+
 /*! @brief Function that controls the Slave Select (SSEL) signal
  * This pin is controlled manually because the internal SSP driver resets the SSEL pin every 8 bits that are transfered
  */
@@ -96,9 +127,26 @@ void ssp_ssel_control( uint8_t id, uint8_t state )
     gpio_set_pin_state( PIN_PORT(ssp_cfg[id].ssel_pin), PIN_NUMBER(ssp_cfg[id].ssel_pin), state );
 }
 
-void ssp_init( uint8_t id, uint32_t bitrate, uint8_t frame_sz, bool master_mode, bool poll )
+/* GPDMA channels held by the SSP interfaces */
+static uint8_t ssp_dma_channels;
+
+/* lpcopen returns channel 0 both when it is free and when no channel is left, a channel we already hold means the latter */
+static bool ssp_dma_channel_get( uint32_t conn, uint8_t *ch )
+{
+    *ch = Chip_GPDMA_GetFreeChannel(LPC_GPDMA, conn);
+
+    if (ssp_dma_channels & (1 << *ch)) {
+        return false;
+    }
+    ssp_dma_channels |= (1 << *ch);
+    return true;
+}
+
+void ssp_init( uint8_t id, uint32_t bitrate, uint8_t frame_sz, bool master_mode, uint8_t mode )
 {
-    ssp_cfg[id].polling = poll;
+    static bool gpdma_ready = false;
+
+    ssp_cfg[id].mode = mode;
     ssp_cfg[id].frame_size = frame_sz;
 
     /* Set up clock and muxing for SSP0/1 interface */
@@ -110,25 +158,91 @@ void ssp_init( uint8_t id, uint32_t bitrate, uint8_t frame_sz, bool master_mode,
     Chip_SSP_SetFormat(ssp_cfg[id].lpc_id, (frame_sz-1), SSP_FRAMEFORMAT_SPI, SSP_CLOCK_CPHA0_CPOL0);
     Chip_SSP_Enable(ssp_cfg[id].lpc_id);
 
-    if (!poll) {
-        /* Configure interruption priority and enable it */
+    if (mode != SSP_POLLING) {
+        /* Configure interruption priority and enable it (the short transfers of the DMA mode use it too) */
         NVIC_SetPriority( ssp_cfg[id].irq, configMAX_SYSCALL_INTERRUPT_PRIORITY );
         NVIC_EnableIRQ( ssp_cfg[id].irq );
     }
 
+    if (mode == SSP_DMA) {
+        if (!gpdma_ready) {
+            Chip_GPDMA_Init(LPC_GPDMA);
+            NVIC_SetPriority( DMA_IRQn, configMAX_SYSCALL_INTERRUPT_PRIORITY );
+            NVIC_EnableIRQ( DMA_IRQn );
+            gpdma_ready = true;
+        }
+
+        /* Each interface keeps its channels, the initialization is run again before every firmware upgrade */
+        if (!ssp_cfg[id].dma_ready && ssp_dma_channel_get(ssp_cfg[id].dma_tx_conn, &ssp_cfg[id].dma_tx_ch)) {
+            if (ssp_dma_channel_get(ssp_cfg[id].dma_rx_conn, &ssp_cfg[id].dma_rx_ch)) {
+                ssp_cfg[id].dma_ready = 1;
+            } else {
+                ssp_dma_channels &= ~(1 << ssp_cfg[id].dma_tx_ch);
+                Chip_GPDMA_Stop(LPC_GPDMA, ssp_cfg[id].dma_tx_ch);
+            }
+        }
+
+        if (!ssp_cfg[id].dma_ready) {
+            /* No GPDMA channel left, the transfers stay interrupt driven */
+            ssp_cfg[id].mode = SSP_INTERRUPT;
+        }
+    }
+
 }
 
 uint8_t *tx_ssp;
 uint8_t *rx_ssp;
 
+/* Starts the receive channel first, so no frame is missed once the transmit one feeds the FIFO */
+static bool ssp_dma_start( uint8_t id, uint32_t length )
+{
+    Chip_SSP_Int_FlushData(ssp_cfg[id].lpc_id);
+
+    ssp_cfg[id].dma_busy = 1;
+
+    if ((Chip_GPDMA_Transfer(LPC_GPDMA, ssp_cfg[id].dma_rx_ch, ssp_cfg[id].dma_rx_conn, (uint32_t) rx_ssp,
+                             GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA, length) != SUCCESS) ||
+        (Chip_GPDMA_Transfer(LPC_GPDMA, ssp_cfg[id].dma_tx_ch, (uint32_t) tx_ssp, ssp_cfg[id].dma_tx_conn,
+                             GPDMA_TRANSFERTYPE_M2P_CONTROLLER_DMA, length) != SUCCESS)) {
+        Chip_GPDMA_ChannelCmd(LPC_GPDMA, ssp_cfg[id].dma_rx_ch, DISABLE);
+        ssp_cfg[id].dma_busy = 0;
+        return false;
+    }
+
+    Chip_SSP_DMA_Enable(ssp_cfg[id].lpc_id);
+    return true;
+}
+
+/* Called when the caller gave up waiting, the channels must not write to the buffers once they are freed */
+static void ssp_dma_abort( uint8_t id )
+{
+    taskENTER_CRITICAL();
+    if (ssp_cfg[id].dma_busy) {
+        Chip_GPDMA_ChannelCmd(LPC_GPDMA, ssp_cfg[id].dma_tx_ch, DISABLE);
+        Chip_GPDMA_ChannelCmd(LPC_GPDMA, ssp_cfg[id].dma_rx_ch, DISABLE);
+        Chip_GPDMA_ClearIntPending(LPC_GPDMA, GPDMA_STATCLR_INTTC, ssp_cfg[id].dma_tx_ch);
+        Chip_GPDMA_ClearIntPending(LPC_GPDMA, GPDMA_STATCLR_INTTC, ssp_cfg[id].dma_rx_ch);
+        Chip_SSP_DMA_Disable(ssp_cfg[id].lpc_id);
+        ssp_cfg[id].dma_busy = 0;
+        ssp_ssel_control(id, DEASSERT);
+    }
+    taskEXIT_CRITICAL();
+}
+
 void ssp_write_read( uint8_t id, uint8_t *tx_buf, uint32_t tx_len, uint8_t *rx_buf, uint32_t rx_len, uint32_t timeout )
 {
     Chip_SSP_DATA_SETUP_T * data_st = &ssp_cfg[id].xf_setup;
+    bool dma;
 
-    tx_ssp = pvPortMalloc(tx_len);
+    /* The whole transfer is clocked out of the TX buffer, the read phase sends dummy bytes */
+    tx_ssp = pvPortMalloc(rx_len+tx_len);
     rx_ssp = pvPortMalloc(rx_len+tx_len);
 
     memcpy(tx_ssp, tx_buf, tx_len);
+    memset(tx_ssp + tx_len, 0xFF, rx_len);
+
+    dma = (ssp_cfg[id].mode == SSP_DMA) && (ssp_cfg[id].frame_size <= 8) &&
+          (rx_len+tx_len >= SSP_DMA_MIN_LEN) && (rx_len+tx_len <= SSP_DMA_MAX_LEN);
 
     ssp_cfg[id].caller_task = xTaskGetCurrentTaskHandle();
     data_st->tx_cnt = 0;
@@ -140,9 +254,14 @@ void ssp_write_read( uint8_t id, uint8_t *tx_buf, uint32_t tx_len, uint8_t *rx_b
     /* Assert Slave Select pin to enable the transfer */
     ssp_ssel_control(id, ASSERT);
 
-    if (ssp_cfg[id].polling) {
+    if (ssp_cfg[id].mode == SSP_POLLING) {
         Chip_SSP_RWFrames_Blocking(ssp_cfg[id].lpc_id, data_st);
         ssp_ssel_control(id, DEASSERT);
+    } else if (dma && ssp_dma_start(id, rx_len+tx_len)) {
+        /* Wait until the receive channel is done */
+        if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+            ssp_dma_abort(id);
+        }
     } else {
         Chip_SSP_Int_FlushData(ssp_cfg[id].lpc_id);
 
@@ -29,6 +29,7 @@
 
 #include "chip_lpc175x_6x.h"
 #include "ssp_17xx_40xx.h"
+#include "gpdma_17xx_40xx.h"
 #include "FreeRTOS.h"
 #include "task.h"
 
@@ -46,6 +47,17 @@
 #define SSP_MASTER       1
 #define SSP_INTERRUPT    0
 #define SSP_POLLING      1
+#define SSP_DMA          2
+
+/**
+ * @brief Shortest transfer moved by the GPDMA in SSP_DMA mode, shorter ones (and 16 bits frames) are interrupt driven
+ */
+#define SSP_DMA_MIN_LEN  16
+
+/**
+ * @brief Longest transfer moved by the GPDMA (12 bits transfer size)
+ */
+#define SSP_DMA_MAX_LEN  4095
 
 /**
  * @brief Slave select states
@@ -62,13 +74,26 @@ typedef struct ssp_config {
     LPC_SSP_T * lpc_id;
     IRQn_Type irq;
     uint32_t ssel_pin;
-    uint8_t polling;
+    uint8_t mode;
     uint8_t frame_size;
     Chip_SSP_DATA_SETUP_T xf_setup;
     TaskHandle_t caller_task;
+    uint32_t dma_tx_conn;
+    uint32_t dma_rx_conn;
+    uint8_t dma_tx_ch;
+    uint8_t dma_rx_ch;
+    uint8_t dma_ready;
+    volatile uint8_t dma_busy;
 } ssp_config_t;
 
-void ssp_init( uint8_t id, uint32_t bitrate, uint8_t frame_sz, bool master_mode, bool poll );
+/**
+ * @brief Initialize an SSP interface
+ *
+ * @param mode SSP_POLLING, SSP_INTERRUPT (one interrupt per FIFO service) or SSP_DMA (the GPDMA moves the frames, a single
+ * completion interrupt per direction). The GPDMA channels are allocated on the first SSP_DMA initialization of the
+ * interface and kept afterwards, the interface falls back to SSP_INTERRUPT when none is left.
+ */
+void ssp_init( uint8_t id, uint32_t bitrate, uint8_t frame_sz, bool master_mode, uint8_t mode );
 void ssp_ssel_control( uint8_t id, uint8_t state );
 void ssp_write_read( uint8_t id, uint8_t *tx_buf, uint32_t tx_len, uint8_t *rx_buf, uint32_t rx_len, uint32_t timeout );
 
@@ -76,7 +101,7 @@ void ssp_write_read( uint8_t id, uint8_t *tx_buf, uint32_t tx_len, uint8_t *rx_b
 #define ssp_chip_deinit(id)                           Chip_SSP_DeInit(SSP(id))
 #define ssp_flush_rx(id)                              Chip_SSP_Int_FlushData(SSP(id))
 #define ssp_set_bitrate(id, bitrate)                  Chip_SSP_SetBitRate(SSP(id), bitrate)
-#define ssp_write(id, buffer, buffer_len)             ssp_write_read(id, buffer, buffer_len, NULL, 0, 0)
+#define ssp_write(id, buffer, buffer_len)             ssp_write_read(id, buffer, buffer_len, NULL, 0, portMAX_DELAY)
 #define ssp_read(id, buffer, buffer_len, timeout)     ssp_write_read(id, NULL, 0, buffer, buffer_len, timeout)
 
 #endif
@@ -514,6 +514,16 @@ void Chip_I2C_SlaveSetup(I2C_ID_T id,
 						 I2C_EVENTHANDLER_T event,
 						 uint8_t addrMask);
 
+/**
+ * @brief	Abort the slave transfer in progress
+ * @param	id		: I2C peripheral ID (I2C0, I2C1 ... etc)
+ * @return	Nothing
+ * @note	The transfer is forgotten without any event being sent, its
+ * buffer has to be reset by the caller. Unless a master transfer is in
+ * progress, the slave addresses are acknowledged again.
+ */
+void Chip_I2C_SlaveAbort(I2C_ID_T id);
+
 /**
  * @brief	I2C Slave event handler
  * @param	id		: I2C peripheral ID (I2C0, I2C1 ... etc)
@@ -522,6 +522,17 @@ void Chip_I2C_SlaveSetup(I2C_ID_T id,
 	iic->flags |= 1 << (sid + 8);
 }
 
+/* Abort the slave transfer in progress and acknowledge our addresses again */
+void Chip_I2C_SlaveAbort(I2C_ID_T id)
+{
+	struct i2c_interface *iic = &i2c[id];
+
+	iic->sXfer = 0;
+	if (SLAVE_ACTIVE(iic) && !iic->mXfer) {
+		startSlaverXfer(iic->ip);
+	}
+}
+
 /* I2C Slave event handler */
 void Chip_I2C_SlaveStateHandler(I2C_ID_T id)
 {